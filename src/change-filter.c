@@ -0,0 +1,415 @@
+#include <string.h>
+
+#include "change-filter.h"
+
+/** @brief Policy of a single property. Rules are never removed, so the index
+ * of a rule stays valid, a removed policy is all zeros. */
+struct _filter_rule
+{
+  const property_desc *desc;
+  change_policy policy;
+};
+
+typedef struct _filter_rule filter_rule;
+
+/** @brief What was last notified of a single property of a modem */
+struct _filter_sent
+{
+  /** monotonic time in microseconds, 0 if never notified */
+  gint64 time;
+  gint64 value;
+  /** whether @a value holds a number */
+  gboolean known;
+};
+
+typedef struct _filter_sent filter_sent;
+
+/** @brief State of a single modem */
+struct _filter_modem
+{
+  change_filter *filter;
+  /** pooled path, held back changes are notified with the record current
+   * when they are due, no reference is kept so records are not copied on
+   * every change */
+  const gchar *path;
+  /** OFONO_MODEM_CHANGED_* bits held back until their interval elapses */
+  guint64 held;
+  /** #filter_sent of every rule */
+  GArray *sent;
+  GSource *timer;
+};
+
+typedef struct _filter_modem filter_modem;
+
+struct _change_filter
+{
+  change_filter_context_fn get_context;
+  change_filter_lookup_fn lookup;
+  change_filter_deliver_fn deliver;
+  gpointer user_data;
+  /** #filter_rule */
+  GArray *rules;
+  /** pooled path -> #filter_modem */
+  GHashTable *modems;
+};
+
+/* returned by change_filter_check() for changes that are not notified */
+#define FILTER_DROP G_MAXINT64
+
+static void
+change_filter_modem_cancel(filter_modem *fm)
+{
+  if (fm->timer)
+  {
+    g_source_destroy(fm->timer);
+    g_source_unref(fm->timer);
+    fm->timer = NULL;
+  }
+}
+
+static void
+change_filter_modem_free(gpointer data)
+{
+  filter_modem *fm = data;
+
+  change_filter_modem_cancel(fm);
+  g_array_free(fm->sent, TRUE);
+  g_free(fm);
+}
+
+/**
+ * @brief Creates an empty filter, it passes every change until a policy is
+ * set
+ *
+ * @param get_context Returns the main context timers are attached to
+ * @param lookup Returns the current record of a modem once held back changes
+ * are due
+ * @param deliver Called with the changes held back, once they are due
+ * @param user_data User data passed to @a lookup and @a deliver
+ *
+ * @return The filter, free with #change_filter_free
+ */
+change_filter *
+change_filter_new(change_filter_context_fn get_context,
+                  change_filter_lookup_fn lookup,
+                  change_filter_deliver_fn deliver, gpointer user_data)
+{
+  change_filter *filter = g_new0(change_filter, 1);
+
+  filter->get_context = get_context;
+  filter->lookup = lookup;
+  filter->deliver = deliver;
+  filter->user_data = user_data;
+  filter->rules = g_array_new(FALSE, FALSE, sizeof(filter_rule));
+  filter->modems = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                         change_filter_modem_free);
+
+  return filter;
+}
+
+/**
+ * @brief Frees a filter, changes held back are dropped
+ *
+ * @param filter Filter
+ */
+void
+change_filter_free(change_filter *filter)
+{
+  g_hash_table_destroy(filter->modems);
+  g_array_free(filter->rules, TRUE);
+  g_free(filter);
+}
+
+/**
+ * @brief Sets or removes the policy of a property. Changes already held back
+ * are checked against the new policy when their interval elapses.
+ *
+ * @param filter Filter
+ * @param desc Property descriptor
+ * @param policy The policy, copied, or NULL to notify every change again
+ */
+void
+change_filter_set_policy(change_filter *filter, const property_desc *desc,
+                         const change_policy *policy)
+{
+  filter_rule rule = {desc, {0, 0, FALSE}};
+  guint i;
+
+  if (policy)
+    rule.policy = *policy;
+
+  for (i = 0; i < filter->rules->len; i++)
+  {
+    filter_rule *r = &g_array_index(filter->rules, filter_rule, i);
+
+    if (r->desc == desc)
+    {
+      r->policy = rule.policy;
+      return;
+    }
+  }
+
+  if (policy)
+    g_array_append_val(filter->rules, rule);
+}
+
+static filter_modem *
+change_filter_modem_get(change_filter *filter, const modem *m)
+{
+  filter_modem *fm = g_hash_table_lookup(filter->modems, m->path);
+
+  if (!fm)
+  {
+    fm = g_new0(filter_modem, 1);
+    fm->filter = filter;
+    fm->path = m->path;
+    fm->sent = g_array_new(FALSE, TRUE, sizeof(filter_sent));
+    g_hash_table_insert(filter->modems, m->path, fm);
+  }
+
+  if (fm->sent->len < filter->rules->len)
+    g_array_set_size(fm->sent, filter->rules->len);
+
+  return fm;
+}
+
+static void
+change_filter_mark_sent(const filter_rule *r, filter_sent *sent,
+                        const modem *m, gint64 now)
+{
+  sent->time = now;
+  sent->known = property_get_number(r->desc, m, &sent->value);
+}
+
+/* 0 to notify now, otherwise the time the change is due or FILTER_DROP */
+static gint64
+change_filter_check(const filter_rule *r, const filter_sent *sent,
+                    const modem *m, gint64 now)
+{
+  gint64 value;
+  gint64 due;
+
+  if (r->policy.deadband && sent->known &&
+      property_get_number(r->desc, m, &value) &&
+      ABS(value - sent->value) < (gint64)r->policy.deadband)
+  {
+    return FILTER_DROP;
+  }
+
+  if (!r->policy.interval || !sent->time)
+    return 0;
+
+  due = sent->time + (gint64)r->policy.interval * 1000;
+
+  if (now >= due)
+    return 0;
+
+  return r->policy.latest ? due : FILTER_DROP;
+}
+
+static gboolean change_filter_timeout_cb(gpointer data);
+
+static void
+change_filter_schedule(filter_modem *fm, gint64 now)
+{
+  change_filter *filter = fm->filter;
+  gint64 due = FILTER_DROP;
+  guint i;
+
+  change_filter_modem_cancel(fm);
+
+  /* rules set after the last change have nothing held back */
+  for (i = 0; i < fm->sent->len; i++)
+  {
+    const filter_rule *r = &g_array_index(filter->rules, filter_rule, i);
+    const filter_sent *sent = &g_array_index(fm->sent, filter_sent, i);
+
+    if (fm->held & r->desc->changed)
+      due = MIN(due, sent->time + (gint64)r->policy.interval * 1000);
+  }
+
+  if (due == FILTER_DROP)
+    return;
+
+  fm->timer = g_timeout_source_new((MAX(due - now, 0) + 999) / 1000);
+  g_source_set_callback(fm->timer, change_filter_timeout_cb, fm, NULL);
+  g_source_attach(fm->timer, filter->get_context());
+}
+
+/* the deliver callback may free the filter, nothing is touched after it */
+static gboolean
+change_filter_timeout_cb(gpointer data)
+{
+  filter_modem *fm = data;
+  change_filter *filter = fm->filter;
+  const modem *m = filter->lookup(fm->path, filter->user_data);
+  gint64 now = g_get_monotonic_time();
+  guint64 changed = 0;
+  guint i;
+
+  g_source_unref(fm->timer);
+  fm->timer = NULL;
+
+  /* removed meanwhile, change_filter_forget() follows */
+  if (!m)
+  {
+    fm->held = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  for (i = 0; i < fm->sent->len; i++)
+  {
+    const filter_rule *r = &g_array_index(filter->rules, filter_rule, i);
+    filter_sent *sent = &g_array_index(fm->sent, filter_sent, i);
+    guint64 bits = fm->held & r->desc->changed;
+    gint64 due;
+
+    if (!bits)
+      continue;
+
+    due = change_filter_check(r, sent, m, now);
+
+    if (due == 0)
+    {
+      change_filter_mark_sent(r, sent, m, now);
+      changed |= bits;
+    }
+
+    /* timers may fire a bit early, those wait for the next one */
+    if (due == 0 || due == FILTER_DROP)
+      fm->held &= ~bits;
+  }
+
+  if (fm->held)
+    change_filter_schedule(fm, now);
+
+  if (changed)
+    filter->deliver(m, changed, filter->user_data);
+
+  modem_unref(m);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * @brief Applies the policies to a change of a modem. Changes within the
+ * interval of a "latest" policy are held back and passed to the deliver
+ * callback once it elapses.
+ *
+ * @param filter Filter
+ * @param m Current modem record
+ * @param changed OFONO_MODEM_CHANGED_* mask, #OFONO_MODEM_CHANGED_ALL for a
+ * new modem, which is never filtered
+ *
+ * @return OFONO_MODEM_CHANGED_* mask of the changes to notify now
+ */
+guint64
+change_filter_apply(change_filter *filter, const modem *m, guint64 changed)
+{
+  filter_modem *fm;
+  gint64 now;
+  guint i;
+
+  if (!filter->rules->len)
+    return changed;
+
+  fm = change_filter_modem_get(filter, m);
+  now = g_get_monotonic_time();
+
+  for (i = 0; i < filter->rules->len; i++)
+  {
+    const filter_rule *r = &g_array_index(filter->rules, filter_rule, i);
+    filter_sent *sent = &g_array_index(fm->sent, filter_sent, i);
+    guint64 bits = changed & r->desc->changed;
+    gint64 due;
+
+    if (!bits)
+      continue;
+
+    /* the values of a new modem are the reference of the deadband */
+    if (changed == OFONO_MODEM_CHANGED_ALL)
+    {
+      sent->known = property_get_number(r->desc, m, &sent->value);
+      continue;
+    }
+
+    due = change_filter_check(r, sent, m, now);
+
+    if (due == 0)
+    {
+      change_filter_mark_sent(r, sent, m, now);
+      fm->held &= ~bits;
+    }
+    else
+    {
+      changed &= ~bits;
+
+      if (due != FILTER_DROP && !(fm->held & bits))
+      {
+        fm->held |= bits;
+        change_filter_schedule(fm, now);
+      }
+    }
+  }
+
+  if (!fm->held)
+    change_filter_modem_cancel(fm);
+
+  return changed;
+}
+
+/**
+ * @brief Drops the state of a removed modem, including held back changes
+ *
+ * @param filter Filter
+ * @param path Pooled modem path
+ */
+void
+change_filter_forget(change_filter *filter, const gchar *path)
+{
+  g_hash_table_remove(filter->modems, path);
+}
+
+/**
+ * @brief Drops the state of some fields of a modem, e.g. once their interface
+ * is closed. Their changes held back are not notified and their next change
+ * is not limited.
+ *
+ * @param filter Filter
+ * @param path Pooled modem path
+ * @param changed OFONO_MODEM_CHANGED_* mask of the fields
+ */
+void
+change_filter_forget_fields(change_filter *filter, const gchar *path,
+                            guint64 changed)
+{
+  filter_modem *fm = g_hash_table_lookup(filter->modems, path);
+  guint i;
+
+  if (!fm)
+    return;
+
+  for (i = 0; i < fm->sent->len; i++)
+  {
+    const filter_rule *r = &g_array_index(filter->rules, filter_rule, i);
+
+    if (r->desc->changed & changed)
+      memset(&g_array_index(fm->sent, filter_sent, i), 0, sizeof(filter_sent));
+  }
+
+  fm->held &= ~changed;
+
+  if (!fm->held)
+    change_filter_modem_cancel(fm);
+}
+
+/**
+ * @brief Drops the state of all modems, the policies are kept
+ *
+ * @param filter Filter
+ */
+void
+change_filter_reset(change_filter *filter)
+{
+  g_hash_table_remove_all(filter->modems);
+}
@@ -0,0 +1,27 @@
+#ifndef __ICD_OFONO_CHANGE_FILTER_H__
+#define __ICD_OFONO_CHANGE_FILTER_H__
+
+#include <glib.h>
+
+#include "modem.h"
+#include "ofono-manager.h"
+#include "property.h"
+
+/* applies change policies to a stream of modem changes */
+typedef struct _change_filter change_filter;
+
+/* called with the changes held back once their interval has elapsed */
+typedef void (*change_filter_deliver_fn)(const modem *m, guint64 changed, gpointer user_data);
+typedef GMainContext *(*change_filter_context_fn)(void);
+/* returns a new reference to the current record of a modem or NULL */
+typedef const modem *(*change_filter_lookup_fn)(const gchar *path, gpointer user_data);
+
+change_filter *change_filter_new(change_filter_context_fn get_context, change_filter_lookup_fn lookup, change_filter_deliver_fn deliver, gpointer user_data);
+void change_filter_free(change_filter *filter);
+void change_filter_set_policy(change_filter *filter, const property_desc *desc, const change_policy *policy);
+guint64 change_filter_apply(change_filter *filter, const modem *m, guint64 changed);
+void change_filter_forget(change_filter *filter, const gchar *path);
+void change_filter_forget_fields(change_filter *filter, const gchar *path, guint64 changed);
+void change_filter_reset(change_filter *filter);
+
+#endif /* __ICD_OFONO_CHANGE_FILTER_H__ */
@@ -1,42 +1,120 @@
 #include <glib.h>
+#include <gio/gio.h>
 #include <dbus/dbus.h>
 
 #include "dbus-helpers.h"
 
+static gboolean
+dbus_helper_string_is_valid(int type, const char *s)
+{
+  if (!s)
+    return FALSE;
+
+  switch (type)
+  {
+    case DBUS_TYPE_OBJECT_PATH:
+      return dbus_validate_path(s, NULL);
+    case DBUS_TYPE_SIGNATURE:
+      return dbus_signature_validate(s, NULL);
+    default:
+      return dbus_validate_utf8(s, NULL);
+  }
+}
+
+static gboolean
+dbus_helper_append_string_array(DBusMessageIter *iter,
+                                const char *const *strv)
+{
+  DBusMessageIter array;
+
+  if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+                                        DBUS_TYPE_STRING_AS_STRING, &array))
+  {
+    return FALSE;
+  }
+
+  for (; strv && *strv; strv++)
+  {
+    if (!dbus_helper_string_is_valid(DBUS_TYPE_STRING, *strv) ||
+        !dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, strv))
+    {
+      dbus_message_iter_abandon_container(iter, &array);
+      return FALSE;
+    }
+  }
+
+  return dbus_message_iter_close_container(iter, &array);
+}
+
+/**
+ * @brief Appends the name and the variant value of a property, as taken by
+ * SetProperty
+ *
+ * @param iter Append iterator
+ * @param property Property name
+ * @param type Any basic D-Bus type, or DBUS_TYPE_ARRAY for an array of
+ * strings
+ * @param value Pointer to the value, as for dbus_message_iter_append_basic().
+ * For DBUS_TYPE_ARRAY a pointer to a NULL terminated string vector.
+ *
+ * @return TRUE on success, FALSE if the type is not supported, the value is
+ * not valid for its type or on out of memory
+ */
 gboolean
 dbus_helper_append_property(DBusMessageIter *iter, const char *property,
-                            int type, void *value)
+                            int type, const void *value)
 {
   DBusMessageIter variant;
-  char *type_str;
+  char signature[3] = {0};
+  dbus_bool_t b;
+  gboolean rv;
 
-  switch(type)
+  if (type == DBUS_TYPE_ARRAY)
   {
-    case DBUS_TYPE_BOOLEAN:
-    {
-      type_str = DBUS_TYPE_BOOLEAN_AS_STRING;
-      break;
-    }
-    case DBUS_TYPE_BYTE:
-    {
-      type_str = DBUS_TYPE_BYTE_AS_STRING;
-      break;
-    }
-    case DBUS_TYPE_STRING:
-    {
-      type_str = DBUS_TYPE_STRING_AS_STRING;
-      break;
-    }
-    default:
+    signature[0] = DBUS_TYPE_ARRAY;
+    signature[1] = DBUS_TYPE_STRING;
+  }
+  else if (dbus_helper_is_basic_type(type))
+    signature[0] = type;
+  else
+    return FALSE;
+
+  if (type == DBUS_TYPE_STRING || type == DBUS_TYPE_OBJECT_PATH ||
+      type == DBUS_TYPE_SIGNATURE)
+  {
+    /* libdbus treats invalid strings as a programming error */
+    if (!dbus_helper_string_is_valid(type, *(const char *const *)value))
       return FALSE;
   }
+  else if (type == DBUS_TYPE_BOOLEAN)
+  {
+    /* and so booleans other than 0 or 1 */
+    b = *(const dbus_bool_t *)value ? TRUE : FALSE;
+    value = &b;
+  }
+
+  if (!dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &property) ||
+      !dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, signature,
+                                        &variant))
+  {
+    return FALSE;
+  }
+
+  if (type == DBUS_TYPE_ARRAY)
+  {
+    rv = dbus_helper_append_string_array(
+          &variant, *(const char *const *const *)value);
+  }
+  else
+    rv = dbus_message_iter_append_basic(&variant, type, value);
 
-  dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &property);
-  dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, type_str, &variant);
-  dbus_message_iter_append_basic(&variant, DBUS_TYPE_BOOLEAN, value);
-  dbus_message_iter_close_container(iter, &variant);
+  if (!rv)
+  {
+    dbus_message_iter_abandon_container(iter, &variant);
+    return FALSE;
+  }
 
-  return TRUE;
+  return dbus_message_iter_close_container(iter, &variant);
 }
 
 int
@@ -104,3 +182,32 @@ dbus_helper_read_basic_property(DBusMessageIter *iter, const char **property,
 
   return rv;
 }
+
+/**
+ * @brief Converts a D-Bus error reply to a #GError. The remote error name can
+ * be retrieved with g_dbus_error_get_remote_error().
+ *
+ * @param error Return location for the error, may be NULL
+ * @param reply Error reply
+ */
+void
+dbus_helper_set_error(GError **error, DBusMessage *reply)
+{
+  const char *message = NULL;
+
+  if (!error)
+    return;
+
+  if (dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_ERROR)
+  {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "Unexpected reply");
+    return;
+  }
+
+  dbus_message_get_args(reply, NULL,
+                        DBUS_TYPE_STRING, &message,
+                        DBUS_TYPE_INVALID);
+  g_dbus_error_set_dbus_error(error, dbus_message_get_error_name(reply),
+                              message ? message : "", NULL);
+}
@@ -1,9 +1,11 @@
 #include <dbus/dbus.h>
 #include <glib.h>
+#include <gio/gio.h>
 
-gboolean dbus_helper_append_property(DBusMessageIter *iter, const char *property, int type, void *value);
+gboolean dbus_helper_append_property(DBusMessageIter *iter, const char *property, int type, const void *value);
 int dbus_helper_read_basic_dict_property(DBusMessageIter *iter, const char **property, DBusBasicValue *value);
 int dbus_helper_read_basic_property(DBusMessageIter *iter, const char **property, DBusBasicValue *value);
+void dbus_helper_set_error(GError **error, DBusMessage *reply);
 
 #define dbus_helper_is_basic_type(t) \
   ( \
@@ -1,7 +1,142 @@
 #include <glib.h>
 
+#include <string.h>
+
 #include "log.h"
 #include "modem.h"
+#include "string-pool.h"
+
+/* Reference count and version are kept in front of the public structure,
+ * strings that fit are stored behind it, so a record is a single slice.
+ * Strings that repeat across modems are pooled instead. */
+struct _modem_block
+{
+  gint refcount;
+  guint64 version;
+  modem m;
+  gchar imei[20];
+  gchar imsi[16];
+  gchar mcc[4];
+  gchar mnc[4];
+};
+
+typedef struct _modem_block modem_block;
+
+#define MODEM_BLOCK(_m) \
+  ((modem_block *)((guint8 *)(_m) - G_STRUCT_OFFSET(modem_block, m)))
+
+struct _modem_context_block
+{
+  gint refcount;
+  modem_context c;
+};
+
+typedef struct _modem_context_block modem_context_block;
+
+#define MODEM_CONTEXT_BLOCK(_c) \
+  ((modem_context_block *)((guint8 *)(_c) - \
+                           G_STRUCT_OFFSET(modem_context_block, c)))
+
+/** @brief String field of #modem and its inline storage in #modem_block */
+struct _modem_string
+{
+  glong field;
+  /** 0 if the string is never stored inline */
+  glong slot;
+  gsize size;
+  /** only for small vocabularies, pooled strings are never freed */
+  gboolean pooled;
+};
+
+typedef struct _modem_string modem_string;
+
+#define MODEM_STRING(_field, _slot) \
+  {G_STRUCT_OFFSET(modem, _field), G_STRUCT_OFFSET(modem_block, _slot), \
+   sizeof(((modem_block *)NULL)->_slot), FALSE}
+
+#define MODEM_POOLED_STRING(_field) \
+  {G_STRUCT_OFFSET(modem, _field), 0, 0, TRUE}
+
+#define MODEM_OWNED_STRING(_field) \
+  {G_STRUCT_OFFSET(modem, _field), 0, 0, FALSE}
+
+static const modem_string modem_strings[] =
+{
+  MODEM_POOLED_STRING(path),
+  MODEM_STRING(imei, imei),
+  MODEM_STRING(sim.imsi, imsi),
+  MODEM_POOLED_STRING(sim.spn),
+  MODEM_POOLED_STRING(net.name),
+  MODEM_STRING(net.mcc, mcc),
+  MODEM_STRING(net.mnc, mnc),
+  MODEM_POOLED_STRING(conn.bearer),
+  MODEM_OWNED_STRING(lte.apn),
+  MODEM_POOLED_STRING(lte.protocol),
+  MODEM_POOLED_STRING(lte.auth_method),
+  MODEM_OWNED_STRING(lte.username)
+};
+
+static gboolean
+modem_string_is_inline(const modem_block *b, const gchar *s)
+{
+  return s >= (const gchar *)b && s < (const gchar *)(b + 1);
+}
+
+/* strings stored neither inline nor in the pool are owned by the record */
+static gboolean
+modem_string_is_owned(const modem_block *b, const modem_string *desc,
+                      const gchar *s)
+{
+  return !desc->pooled && !modem_string_is_inline(b, s);
+}
+
+static const modem_string *
+modem_string_lookup(const modem *m, gchar **field)
+{
+  glong offset = (guint8 *)field - (guint8 *)m;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(modem_strings); i++)
+  {
+    if (modem_strings[i].field == offset)
+      return &modem_strings[i];
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Sets a string field of a modem. Short values are stored in the
+ * record itself, the path and the values of small vocabularies like the
+ * bearer are pooled, user set values like the APN are copied.
+ *
+ * @param m Modem
+ * @param field String field of @a m, e.g. &m->sim.imsi
+ * @param value New value, can be NULL
+ */
+void
+modem_set_string(modem *m, gchar **field, const char *value)
+{
+  modem_block *b = MODEM_BLOCK(m);
+  const modem_string *desc = modem_string_lookup(m, field);
+
+  g_return_if_fail(desc != NULL);
+
+  if (modem_string_is_owned(b, desc, *field))
+    g_free(*field);
+
+  if (!value)
+    *field = NULL;
+  else if (desc->pooled)
+    *field = (gchar *)string_pool_intern(value);
+  else if (desc->slot && strlen(value) < desc->size)
+  {
+    *field = G_STRUCT_MEMBER_P(b, desc->slot);
+    strcpy(*field, value);
+  }
+  else
+    *field = g_strdup(value);
+}
 
 /**
  * @brief Allocates and initializes #ofono_modem structure.
@@ -9,15 +144,18 @@
  * @param path Modem object path
  * @param powered Whether modem is powered
  *
- * @return Newly allocated #ofono_modem structure. Must be freed with
- * #ofono_modem_free
+ * @return Newly allocated #ofono_modem structure with a single reference.
+ * Must be freed with #modem_free or #modem_unref
  */
 modem *
 modem_new(const char *path, gboolean powered)
 {
-  modem *m = g_new0(modem, 1);
+  modem_block *b = g_slice_new0(modem_block);
+  modem *m = &b->m;
+
+  b->refcount = 1;
 
-  m->path = g_strdup(path);
+  modem_set_string(m, &m->path, path);
   m->powered = powered;
 
   m->emergency_call = -1;
@@ -25,6 +163,13 @@ modem_new(const char *path, gboolean powered)
   m->sim.present = -1;
   m->net.registered = -1;
   m->net.roaming = -1;
+  m->net.status = MODEM_NET_STATUS_NONE;
+  m->net.technology = MODEM_NET_TECHNOLOGY_NONE;
+  m->net.strength = -1;
+  m->conn.attached = -1;
+  m->conn.powered = -1;
+  m->conn.roaming_allowed = -1;
+  m->conn.suspended = -1;
 
   return m;
 }
@@ -40,49 +185,177 @@ modem_new(const char *path, gboolean powered)
 modem *
 modem_dup(const modem *m)
 {
-  modem *rv = modem_new(m->path, m->powered);
+  const modem_block *b = MODEM_BLOCK(m);
+  modem_block *rv = g_slice_dup(modem_block, b);
+  guint i;
 
-  rv->emergency_call = m->emergency_call;
-  rv->online = m->online;
-  rv->interfaces = m->interfaces;
-  rv->imei = g_strdup(m->imei);
+  rv->refcount = 1;
 
-  rv->sim.present = m->sim.present;
-  rv->sim.imsi = g_strdup(m->sim.imsi);
-  rv->sim.spn = g_strdup(m->sim.spn);
+  /* inline strings move with the block, owned ones are copied */
+  for (i = 0; i < G_N_ELEMENTS(modem_strings); i++)
+  {
+    gchar **s = G_STRUCT_MEMBER_P(&rv->m, modem_strings[i].field);
 
-  rv->net.registered = m->net.registered;
-  rv->net.roaming = m->net.roaming;
-  rv->net.name = g_strdup(m->net.name);
+    if (!*s || modem_strings[i].pooled)
+      continue;
 
-  return rv;
+    if (modem_string_is_inline(b, *s))
+      *s = (gchar *)rv + (*s - (const gchar *)b);
+    else
+      *s = g_strdup(*s);
+  }
+
+  /* the context list is replaced, never modified, so it can be shared */
+  if (rv->m.contexts)
+    g_ptr_array_ref(rv->m.contexts);
+
+  return &rv->m;
 }
 
 /**
- * @brief Creates new empty list of #ofono_modem structures
+ * @brief Takes a reference to a modem. Modems handed out by the manager are
+ * never modified once shared, so a reference is a consistent snapshot that
+ * stays valid until released with #modem_unref.
+ *
+ * @param m Modem
+ *
+ * @return @a m
+ */
+const modem *
+modem_ref(const modem *m)
+{
+  g_atomic_int_inc(&MODEM_BLOCK(m)->refcount);
+
+  return m;
+}
+
+/**
+ * @brief Releases a reference to a modem, freeing it with the last one
+ *
+ * @param m Modem
+ */
+void
+modem_unref(const modem *m)
+{
+  modem_block *b;
+  guint i;
+
+  if (!m)
+    return;
+
+  b = MODEM_BLOCK(m);
+
+  if (!g_atomic_int_dec_and_test(&b->refcount))
+    return;
+
+  for (i = 0; i < G_N_ELEMENTS(modem_strings); i++)
+  {
+    gchar *s = G_STRUCT_MEMBER(gchar *, &b->m, modem_strings[i].field);
+
+    if (modem_string_is_owned(b, &modem_strings[i], s))
+      g_free(s);
+  }
+
+  if (b->m.contexts)
+    g_ptr_array_unref(b->m.contexts);
+
+  g_slice_free(modem_block, b);
+}
+
+/**
+ * @brief Tells how many times the modem record was changed. Two snapshots of
+ * the same modem with the same version have the same contents.
+ *
+ * @param m Modem
+ *
+ * @return Version
+ */
+guint64
+modem_version(const modem *m)
+{
+  return MODEM_BLOCK(m)->version;
+}
+
+/**
+ * @brief Creates new empty list of #ofono_modem structures. Keys are the
+ * pooled paths of the records.
  *
  * #return The list
  */
 GHashTable *
 modem_list_create(void)
 {
-  return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
-                               (GDestroyNotify)modem_free);
+  return g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                               (GDestroyNotify)modem_unref);
 }
 
 /**
- * @brief Appends modem in the list of modems. If modem with the same object
+ * @brief Moves a modem in the list of modems. If modem with the same object
  * path already exists, the function will abort.
  *
+ * @param modems List to add the modem in
+ * @param modem Modem to be added, the list takes over the reference
+ *
+ * @return @a modem
+ */
+modem *
+modem_list_insert(GHashTable *modems, modem *modem)
+{
+  g_assert(!g_hash_table_contains(modems, modem->path));
+
+  g_hash_table_insert(modems, modem->path, modem);
+
+  return modem;
+}
+
+/**
+ * @brief Appends a copy of a modem in the list of modems. If modem with the
+ * same object path already exists, the function will abort.
+ *
  * @param modems Poniter to list to replace or add the modem in
  * @param modem Modem to be appended
  */
 void
 modem_list_add(GHashTable *modems, const modem *modem)
 {
-  g_assert(!g_hash_table_contains(modems, modem->path));
+  modem_list_insert(modems, modem_dup(modem));
+}
 
-  g_hash_table_insert(modems, g_strdup(modem->path), modem_dup(modem));
+/**
+ * @brief Gets the record of a modem for modification. If anybody else holds a
+ * reference to it, the record is copied first and the copy replaces it in the
+ * list, so existing references keep seeing the old contents. The version of
+ * the returned record is increased.
+ *
+ * @param modems List of modems
+ * @param path Modem object path
+ *
+ * @return The record to modify or NULL if there is no such modem
+ */
+modem *
+modem_list_modify(GHashTable *modems, const gchar *path)
+{
+  gpointer key;
+  gpointer value;
+  modem *m;
+
+  if (!modems || !g_hash_table_lookup_extended(modems, path, &key, &value))
+    return NULL;
+
+  m = value;
+
+  if (g_atomic_int_get(&MODEM_BLOCK(m)->refcount) > 1)
+  {
+    /* the pooled path stays the key */
+    g_hash_table_steal(modems, key);
+    m = modem_dup(value);
+    g_hash_table_insert(modems, key, m);
+    modem_unref(value);
+  }
+
+  MODEM_BLOCK(m)->version++;
+
+  return m;
 }
 
 modem *
@@ -108,19 +381,14 @@ modem_list_remove(GHashTable *modems, const gchar *path)
 }
 
 /**
- * @brief Frees #ofono_modem structure and its data
+ * @brief Releases a reference to #ofono_modem structure, same as #modem_unref
  *
  * @param modem structure to free
  */
 void
 modem_free(modem *modem)
 {
-  g_free(modem->path);
-  g_free(modem->imei);
-  g_free(modem->sim.imsi);
-  g_free(modem->sim.spn);
-  g_free(modem->net.name);
-  g_free(modem);
+  modem_unref(modem);
 }
 
 /**
@@ -135,6 +403,264 @@ modem_list_free(GHashTable *modems)
     g_hash_table_destroy(modems);
 }
 
+/**
+ * @brief Allocates an empty context record
+ *
+ * @param path Context object path
+ *
+ * @return New context with a single reference, release it with
+ * #modem_context_unref
+ */
+modem_context *
+modem_context_new(const char *path)
+{
+  modem_context_block *b = g_slice_new0(modem_context_block);
+
+  b->refcount = 1;
+  b->c.path = (gchar *)string_pool_intern(path);
+  b->c.active = -1;
+
+  return &b->c;
+}
+
+static void
+modem_context_settings_copy(modem_context_settings *dst,
+                            const modem_context_settings *src)
+{
+  dst->interface = g_strdup(src->interface);
+  dst->method = g_strdup(src->method);
+  dst->address = g_strdup(src->address);
+  dst->netmask = g_strdup(src->netmask);
+  dst->prefix_length = src->prefix_length;
+  dst->gateway = g_strdup(src->gateway);
+  dst->dns = g_strdupv(src->dns);
+}
+
+/**
+ * @brief Frees the strings of a settings record, the record itself is not
+ * freed nor zeroed
+ *
+ * @param settings Settings
+ */
+void
+modem_context_settings_clear(modem_context_settings *settings)
+{
+  g_free(settings->interface);
+  g_free(settings->method);
+  g_free(settings->address);
+  g_free(settings->netmask);
+  g_free(settings->gateway);
+  g_strfreev(settings->dns);
+}
+
+/**
+ * @brief Copies a context record for modification
+ *
+ * @param c Context
+ *
+ * @return New context with a single reference
+ */
+modem_context *
+modem_context_dup(const modem_context *c)
+{
+  modem_context *rv = modem_context_new(c->path);
+
+  rv->active = c->active;
+  rv->apn = g_strdup(c->apn);
+  rv->type = g_strdup(c->type);
+  rv->protocol = g_strdup(c->protocol);
+  rv->name = g_strdup(c->name);
+  modem_context_settings_copy(&rv->ipv4, &c->ipv4);
+  modem_context_settings_copy(&rv->ipv6, &c->ipv6);
+
+  return rv;
+}
+
+const modem_context *
+modem_context_ref(const modem_context *c)
+{
+  g_atomic_int_inc(&MODEM_CONTEXT_BLOCK(c)->refcount);
+
+  return c;
+}
+
+void
+modem_context_unref(const modem_context *c)
+{
+  modem_context_block *b;
+
+  if (!c)
+    return;
+
+  b = MODEM_CONTEXT_BLOCK(c);
+
+  if (!g_atomic_int_dec_and_test(&b->refcount))
+    return;
+
+  g_free(b->c.apn);
+  g_free(b->c.type);
+  g_free(b->c.protocol);
+  g_free(b->c.name);
+  modem_context_settings_clear(&b->c.ipv4);
+  modem_context_settings_clear(&b->c.ipv6);
+  g_slice_free(modem_context_block, b);
+}
+
+static gint
+modem_context_index(const modem *m, const char *path)
+{
+  guint i;
+
+  if (!m->contexts)
+    return -1;
+
+  for (i = 0; i < m->contexts->len; i++)
+  {
+    const modem_context *c = g_ptr_array_index(m->contexts, i);
+
+    if (c->path == path || !strcmp(c->path, path))
+      return i;
+  }
+
+  return -1;
+}
+
+/**
+ * @brief Finds a context of a modem
+ *
+ * @param m Modem
+ * @param path Context object path
+ *
+ * @return The context or NULL, valid as long as the modem is
+ */
+const modem_context *
+modem_find_context(const modem *m, const char *path)
+{
+  gint i = modem_context_index(m, path);
+
+  return i < 0 ? NULL : g_ptr_array_index(m->contexts, i);
+}
+
+/**
+ * @brief Finds the first context of a modem with the given type
+ *
+ * @param m Modem
+ * @param type Context type, e.g. "internet"
+ *
+ * @return The context or NULL, valid as long as the modem is
+ */
+const modem_context *
+modem_find_context_type(const modem *m, const char *type)
+{
+  guint i;
+
+  if (!m->contexts)
+    return NULL;
+
+  for (i = 0; i < m->contexts->len; i++)
+  {
+    const modem_context *c = g_ptr_array_index(m->contexts, i);
+
+    if (!g_strcmp0(c->type, type))
+      return c;
+  }
+
+  return NULL;
+}
+
+/* the list may be shared with other copies of the record */
+static GPtrArray *
+modem_contexts_copy(const modem *m, gint skip)
+{
+  GPtrArray *contexts;
+  guint i;
+
+  contexts = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)modem_context_unref);
+
+  if (!m->contexts)
+    return contexts;
+
+  for (i = 0; i < m->contexts->len; i++)
+  {
+    if ((gint)i != skip)
+    {
+      g_ptr_array_add(contexts,
+                      (gpointer)modem_context_ref(
+                        g_ptr_array_index(m->contexts, i)));
+    }
+  }
+
+  return contexts;
+}
+
+/**
+ * @brief Adds a context to the record of a modem or replaces the one with
+ * the same path, keeping its position
+ *
+ * @param m Modem being modified
+ * @param context Context, the modem takes over the reference
+ */
+void
+modem_set_context(modem *m, modem_context *context)
+{
+  gint i = modem_context_index(m, context->path);
+  GPtrArray *contexts = modem_contexts_copy(m, -1);
+
+  if (i < 0)
+    g_ptr_array_add(contexts, context);
+  else
+  {
+    modem_context_unref(g_ptr_array_index(contexts, i));
+    g_ptr_array_index(contexts, i) = context;
+  }
+
+  if (m->contexts)
+    g_ptr_array_unref(m->contexts);
+
+  m->contexts = contexts;
+}
+
+/**
+ * @brief Removes a context from the record of a modem
+ *
+ * @param m Modem being modified
+ * @param path Context object path
+ *
+ * @return TRUE if the modem had the context
+ */
+gboolean
+modem_remove_context(modem *m, const char *path)
+{
+  gint i = modem_context_index(m, path);
+  GPtrArray *contexts;
+
+  if (i < 0)
+    return FALSE;
+
+  contexts = modem_contexts_copy(m, i);
+  g_ptr_array_unref(m->contexts);
+  m->contexts = contexts;
+
+  return TRUE;
+}
+
+/**
+ * @brief Drops all contexts of a modem, e.g. when its ConnectionManager
+ * interface goes away
+ *
+ * @param m Modem being modified
+ */
+void
+modem_clear_contexts(modem *m)
+{
+  if (m->contexts)
+  {
+    g_ptr_array_unref(m->contexts);
+    m->contexts = NULL;
+  }
+}
+
 void
 modem_add_interface(modem *modem, guint64 interface)
 {
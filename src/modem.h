@@ -1,3 +1,6 @@
+#ifndef __ICD_OFONO_MODEM_H__
+#define __ICD_OFONO_MODEM_H__
+
 #include <icd/support/icd_dbus.h>
 
 struct _sim
@@ -9,19 +12,121 @@ struct _sim
 
 typedef struct _sim sim;
 
+/** @brief NetworkRegistration "Status" values */
+enum modem_net_status
+{
+  /** not reported yet */
+  MODEM_NET_STATUS_NONE = -1,
+  MODEM_NET_STATUS_UNREGISTERED,
+  MODEM_NET_STATUS_REGISTERED,
+  MODEM_NET_STATUS_SEARCHING,
+  MODEM_NET_STATUS_DENIED,
+  MODEM_NET_STATUS_UNKNOWN,
+  MODEM_NET_STATUS_ROAMING
+};
+
+typedef enum modem_net_status modem_net_status;
+
+/** @brief NetworkRegistration "Technology" values */
+enum modem_net_technology
+{
+  /** not reported yet or not registered */
+  MODEM_NET_TECHNOLOGY_NONE = -1,
+  MODEM_NET_TECHNOLOGY_GSM,
+  MODEM_NET_TECHNOLOGY_EDGE,
+  MODEM_NET_TECHNOLOGY_UMTS,
+  MODEM_NET_TECHNOLOGY_HSPA,
+  MODEM_NET_TECHNOLOGY_LTE,
+  MODEM_NET_TECHNOLOGY_NR
+};
+
+typedef enum modem_net_technology modem_net_technology;
+
 struct _net
 {
   gchar *name;
   gint registered;
   gint roaming;
+  modem_net_status status;
+  modem_net_technology technology;
+  /** signal strength in percent, -1 if unknown */
+  gint8 strength;
+  /** location area code, 0 if unknown */
+  guint16 lac;
+  /** cell id, 0 if unknown */
+  guint32 cell_id;
+  /** mobile country and network codes, stored in the record */
+  gchar *mcc;
+  gchar *mnc;
 };
 
 typedef struct _net net;
 
+struct _conn
+{
+  gint attached;
+  gchar *bearer;
+  gint powered;
+  gint roaming_allowed;
+  gint suspended;
+};
+
+typedef struct _conn conn;
+
+/** @brief Default bearer settings of org.ofono.LongTermEvolution */
+struct _lte
+{
+  gchar *apn;
+  /** "ip", "ipv6" or "dual" */
+  gchar *protocol;
+  /** "none", "pap" or "chap" */
+  gchar *auth_method;
+  gchar *username;
+};
+
+typedef struct _lte lte;
+
+/** @brief IPv4 or IPv6 settings of an active context, all NULL if unknown */
+struct _modem_context_settings
+{
+  gchar *interface;
+  /** "static" or "dhcp", IPv4 only */
+  gchar *method;
+  gchar *address;
+  /** IPv4 only */
+  gchar *netmask;
+  /** IPv6 only, 0 if unknown */
+  guchar prefix_length;
+  gchar *gateway;
+  /** NULL terminated */
+  gchar **dns;
+};
+
+typedef struct _modem_context_settings modem_context_settings;
+
+/** @brief Cached state of an org.ofono.ConnectionContext. Like #modem,
+ * contexts are never modified once shared. */
+struct _modem_context
+{
+  /** Context object path, pooled */
+  gchar *path;
+  gint active;
+  gchar *apn;
+  /** "internet", "mms", "wap", "ims"... */
+  gchar *type;
+  /** "ip", "ipv6" or "dual" */
+  gchar *protocol;
+  gchar *name;
+  modem_context_settings ipv4;
+  modem_context_settings ipv6;
+};
+
+typedef struct _modem_context modem_context;
+
 /** @brief Represents the current state of OFONO modem */
 struct _modem
 {
-  /** Modem object path */
+  /** Modem object path, pooled and valid for the lifetime of the process */
   gchar *path;
   gint emergency_call;
   gboolean powered;
@@ -30,33 +135,94 @@ struct _modem
   guint64 interfaces;
   sim sim;
   net net;
+  conn conn;
+  lte lte;
+  /** const #modem_context pointers in the order oFono reported them, NULL
+   * until the ConnectionManager interface appears */
+  GPtrArray *contexts;
 };
 
 typedef struct _modem modem;
 
 struct _property_changed
 {
+  /** pooled object path the property belongs to */
+  const char *path;
   const char *property;
+  /** D-Bus type of @a val */
+  int type;
   DBusBasicValue val;
 };
 
 typedef struct _property_changed property_changed;
 
+/* bits of the interfaces listed in the modem "Interfaces" property, stable
+ * across releases, new interfaces get new bits */
 #define OFONO_MODEM_INTERFACE_SIM_MANAGER                  0x0000000000000001LL
 #define OFONO_MODEM_INTERFACE_LTE                          0x0000000000000002LL
 #define OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION         0x0000000000000004LL
 #define OFONO_MODEM_INTERFACE_CONNECTION_MANAGER           0x0000000000000008LL
+#define OFONO_MODEM_INTERFACE_ASSISTED_NAVIGATION          0x0000000000000010LL
+#define OFONO_MODEM_INTERFACE_AUDIO_SETTINGS               0x0000000000000020LL
+#define OFONO_MODEM_INTERFACE_CALL_BARRING                 0x0000000000000040LL
+#define OFONO_MODEM_INTERFACE_CALL_FORWARDING              0x0000000000000080LL
+#define OFONO_MODEM_INTERFACE_CALL_METER                   0x0000000000000100LL
+#define OFONO_MODEM_INTERFACE_CALL_SETTINGS                0x0000000000000200LL
+#define OFONO_MODEM_INTERFACE_CALL_VOLUME                  0x0000000000000400LL
+#define OFONO_MODEM_INTERFACE_CELL_BROADCAST               0x0000000000000800LL
+#define OFONO_MODEM_INTERFACE_HANDSFREE                    0x0000000000001000LL
+#define OFONO_MODEM_INTERFACE_IP_MULTIMEDIA_SYSTEM         0x0000000000002000LL
+#define OFONO_MODEM_INTERFACE_LOCATION_REPORTING           0x0000000000004000LL
+#define OFONO_MODEM_INTERFACE_MESSAGE_MANAGER              0x0000000000008000LL
+#define OFONO_MODEM_INTERFACE_MESSAGE_WAITING              0x0000000000010000LL
+#define OFONO_MODEM_INTERFACE_NETWORK_MONITOR              0x0000000000020000LL
+#define OFONO_MODEM_INTERFACE_PHONEBOOK                    0x0000000000040000LL
+#define OFONO_MODEM_INTERFACE_PUSH_NOTIFICATION            0x0000000000080000LL
+#define OFONO_MODEM_INTERFACE_RADIO_SETTINGS               0x0000000000100000LL
+#define OFONO_MODEM_INTERFACE_SIM_AUTHENTICATION           0x0000000000200000LL
+#define OFONO_MODEM_INTERFACE_SIM_TOOLKIT                  0x0000000000400000LL
+#define OFONO_MODEM_INTERFACE_SIRI                         0x0000000000800000LL
+#define OFONO_MODEM_INTERFACE_SMART_MESSAGING              0x0000000001000000LL
+#define OFONO_MODEM_INTERFACE_SUPPLEMENTARY_SERVICES       0x0000000002000000LL
+#define OFONO_MODEM_INTERFACE_TEXT_TELEPHONY               0x0000000004000000LL
+#define OFONO_MODEM_INTERFACE_VOICE_CALL_MANAGER           0x0000000008000000LL
+#define OFONO_MODEM_INTERFACE_ALLOWED_ACCESS_POINTS        0x0000000010000000LL
+#define OFONO_MODEM_INTERFACE_CDMA_CONNECTION_MANAGER      0x0000000020000000LL
+#define OFONO_MODEM_INTERFACE_CDMA_MESSAGE_MANAGER         0x0000000040000000LL
+#define OFONO_MODEM_INTERFACE_CDMA_NETWORK_REGISTRATION    0x0000000080000000LL
+#define OFONO_MODEM_INTERFACE_CDMA_VOICE_CALL_MANAGER      0x0000000100000000LL
+
+#define OFONO_MODEM_INTERFACE_ALL                          0xFFFFFFFFFFFFFFFFLL
 
 modem *modem_new(const char *path, gboolean powered);
 void modem_free(modem *modem);
 modem *modem_dup(const modem *modem);
+const modem *modem_ref(const modem *modem);
+void modem_unref(const modem *modem);
+guint64 modem_version(const modem *modem);
+void modem_set_string(modem *modem, gchar **field, const char *value);
 
 GHashTable *modem_list_create(void);
 void modem_list_add(GHashTable *modems, const modem *modem);
+modem *modem_list_insert(GHashTable *modems, modem *modem);
 void modem_list_remove(GHashTable *modems, const gchar *path);
 modem *modem_list_find(GHashTable *modems, const gchar *path);
+modem *modem_list_modify(GHashTable *modems, const gchar *path);
 void modem_list_free(GHashTable *modems);
 
+modem_context *modem_context_new(const char *path);
+modem_context *modem_context_dup(const modem_context *context);
+const modem_context *modem_context_ref(const modem_context *context);
+void modem_context_unref(const modem_context *context);
+void modem_context_settings_clear(modem_context_settings *settings);
+const modem_context *modem_find_context(const modem *modem, const char *path);
+const modem_context *modem_find_context_type(const modem *modem, const char *type);
+void modem_set_context(modem *modem, modem_context *context);
+gboolean modem_remove_context(modem *modem, const char *path);
+void modem_clear_contexts(modem *modem);
+
 void modem_add_interface(modem *modem, guint64 interface);
 void modem_remove_interface(modem *modem, guint64 interface);
 gboolean modem_interface_supported(modem *modem, guint64 interface);
+
+#endif /* __ICD_OFONO_MODEM_H__ */
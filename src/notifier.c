@@ -2,60 +2,150 @@
 
 struct _notifier
 {
+  /** NULL once removed */
   ofono_notify_fn cb;
   gpointer user_data;
 };
 
 typedef struct _notifier notifier;
 
+struct _ofono_notifier_list
+{
+  notifier *entries;
+  /** used entries, including removed ones */
+  guint len;
+  guint size;
+  /** entries not removed */
+  guint live;
+  /** nesting level of ofono_notifier_notify() calls */
+  guint depth;
+  /** closed while being notified, freed when the last notify returns */
+  gboolean orphaned;
+};
+
+static void
+ofono_notifier_list_free(ofono_notifier_list *l)
+{
+  g_free(l->entries);
+  g_free(l);
+}
+
+/* removed entries are only dropped while nobody iterates the array */
+static void
+ofono_notifier_compact(ofono_notifier_list *l)
+{
+  guint i;
+  guint j = 0;
+
+  for (i = 0; i < l->len; i++)
+  {
+    if (l->entries[i].cb)
+      l->entries[j++] = l->entries[i];
+  }
+
+  l->len = j;
+}
+
 void
-ofono_notifier_register(GSList **notifiers, ofono_notify_fn cb,
+ofono_notifier_register(ofono_notifier_list **notifiers, ofono_notify_fn cb,
                         gpointer user_data)
 {
-  notifier *n = g_new(notifier, 1);
+  ofono_notifier_list *l = *notifiers;
 
-  n->cb = cb;
-  n->user_data = user_data;
+  g_return_if_fail(cb != NULL);
 
-  *notifiers = g_slist_append(*notifiers, n);
+  if (!l)
+    l = *notifiers = g_new0(ofono_notifier_list, 1);
+
+  if (l->len == l->size)
+  {
+    l->size = l->size ? l->size * 2 : 4;
+    l->entries = g_renew(notifier, l->entries, l->size);
+  }
+
+  l->entries[l->len].cb = cb;
+  l->entries[l->len].user_data = user_data;
+  l->len++;
+  l->live++;
 }
 
+/**
+ * @brief Calls every registered callback. Callbacks may register or close
+ * notifiers of the same list, callbacks registered meanwhile are not called
+ * until the next notification.
+ *
+ * @param notifiers List of notifiers
+ * @param data Data passed to the callbacks
+ */
 void
-ofono_notifier_notify(GSList *notifiers, const gpointer data)
+ofono_notifier_notify(ofono_notifier_list *notifiers, const gpointer data)
 {
-  GSList *l = notifiers;
+  guint end;
+  guint i;
 
-  for (l = notifiers; l; l = l->next)
+  if (!notifiers)
+    return;
+
+  end = notifiers->len;
+  notifiers->depth++;
+
+  for (i = 0; i < end; i++)
   {
-    notifier *n = l->data;
+    /* the array may be reallocated by the callback */
+    ofono_notify_fn cb = notifiers->entries[i].cb;
 
-    (n->cb)(data, n->user_data);
+    if (cb)
+      cb(data, notifiers->entries[i].user_data);
+  }
+
+  if (!--notifiers->depth)
+  {
+    if (notifiers->orphaned)
+      ofono_notifier_list_free(notifiers);
+    else if (notifiers->live != notifiers->len)
+      ofono_notifier_compact(notifiers);
   }
 }
 
+/**
+ * @brief Removes all notifiers matching @a cb and @a user_data, or all of
+ * them if both are NULL. The list is set to NULL once it is empty.
+ *
+ * @param notifiers List of notifiers
+ * @param cb Callback
+ * @param user_data User data
+ */
 void
-ofono_notifier_close(GSList **notifiers, ofono_notify_fn cb, gpointer user_data)
+ofono_notifier_close(ofono_notifier_list **notifiers, ofono_notify_fn cb,
+                     gpointer user_data)
 {
-  if (cb || user_data)
+  ofono_notifier_list *l = *notifiers;
+  gboolean all = !cb && !user_data;
+  guint i;
+
+  if (!l)
+    return;
+
+  for (i = 0; i < l->len; i++)
   {
-    GSList *l = *notifiers;
+    notifier *n = &l->entries[i];
 
-    while(l)
+    if (n->cb && (all || (n->cb == cb && n->user_data == user_data)))
     {
-      notifier *n = l->data;
-
-      if (n->cb == cb && n->user_data == user_data)
-      {
-        l = *notifiers = g_slist_remove(*notifiers, n);
-        g_free(n);
-      }
-      else
-        l = l->next;
+      n->cb = NULL;
+      l->live--;
     }
   }
-  else
+
+  if (!l->live)
   {
-    g_slist_free_full(*notifiers, g_free);
     *notifiers = NULL;
+
+    if (l->depth)
+      l->orphaned = TRUE;
+    else
+      ofono_notifier_list_free(l);
   }
+  else if (!l->depth)
+    ofono_notifier_compact(l);
 }
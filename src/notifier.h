@@ -5,8 +5,11 @@
 
 typedef void (*ofono_notify_fn)(const gpointer data, gpointer user_data);
 
-void ofono_notifier_register(GSList **notifiers, ofono_notify_fn cb, gpointer user_data);
-void ofono_notifier_notify(GSList *notifiers, const gpointer data);
-void ofono_notifier_close(GSList **notifiers, ofono_notify_fn cb, gpointer user_data);
+/* NULL is an empty list */
+typedef struct _ofono_notifier_list ofono_notifier_list;
+
+void ofono_notifier_register(ofono_notifier_list **notifiers, ofono_notify_fn cb, gpointer user_data);
+void ofono_notifier_notify(ofono_notifier_list *notifiers, const gpointer data);
+void ofono_notifier_close(ofono_notifier_list **notifiers, ofono_notify_fn cb, gpointer user_data);
 
 #endif /* __ICD_OFONO_NOTIFIER_H__ */
@@ -1,232 +1,73 @@
 #include <glib.h>
 
-#include <string.h>
-
 #include "ofono-conn.h"
+#include "ofono-iface.h"
 #include "log.h"
-#include "dbus-helpers.h"
-#include "modem.h"
-
-static GHashTable *conns = NULL;
 
-static void
-ofono_conn_notifier_notify(const char *path, gpointer data)
+gboolean
+ofono_conn_register(const char *path, ofono_notify_fn cb, gpointer user_data)
 {
-  GSList *notifiers = NULL;
-
-  if (conns)
-    notifiers = g_hash_table_lookup(conns, path);
-
-  if (notifiers)
-    ofono_notifier_notify(notifiers, data);
+  return ofono_iface_register(path, OFONO_IFACE_CONN, cb, user_data);
 }
 
-static gboolean
-ofono_conn_property_changed(const char *path, DBusMessageIter *iter)
+void
+ofono_conn_close(const char *path, ofono_notify_fn cb, gpointer user_data)
 {
-  property_changed pc;
-  gboolean rv = FALSE;
-
-  OFONO_ENTER
-
-  if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_STRING)
-  {
-    int type;
-    dbus_message_iter_get_basic(iter, &pc.property);
-    type = dbus_helper_read_basic_property(iter, &pc.property, &pc.val);
-
-    if (type != DBUS_TYPE_INVALID)
-    {
-      if (dbus_helper_is_basic_type(type))
-        ofono_conn_notifier_notify(path, &pc);
-
-      rv = TRUE;
-    }
-  }
-
-  OFONO_EXIT
-
-  return rv;
+  ofono_iface_close(path, OFONO_IFACE_CONN, cb, user_data);
 }
 
-static void
-ofono_conn_get_properties_cb(DBusPendingCall *pending, void *user_data)
+/**
+ * @brief Subscribes to ContextAdded and ContextRemoved of a modem, the
+ * callback receives the raw signal
+ */
+gboolean
+ofono_conn_contexts_register(const char *path, ofono_notify_fn cb,
+                             gpointer user_data)
 {
-  DBusMessage *reply;
-  gchar *path = user_data;
-
-  OFONO_ENTER
-
-  if (pending)
-  {
-    reply = dbus_pending_call_steal_reply(pending);
-    dbus_pending_call_unref(pending);
-  }
-
-  if (pending && reply)
-  {
-    if (dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_ERROR)
-    {
-      DBusMessageIter iter;
-
-      dbus_message_iter_init(reply, &iter);
-
-      if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
-      {
-        DBusMessageIter array_iter;
-
-        dbus_message_iter_recurse(&iter, &array_iter);
-
-        while (dbus_message_iter_get_arg_type(&array_iter) ==
-               DBUS_TYPE_DICT_ENTRY)
-        {
-          DBusMessageIter dict_iter;
-
-          dbus_message_iter_recurse(&array_iter, &dict_iter);
-          ofono_conn_property_changed(path, &dict_iter);
-
-          dbus_message_iter_next(&array_iter);
-        }
-      }
-    }
-    else
-    {
-      OFONO_WARN("GetProperties returned '%s'",
-                 dbus_message_get_error_name(reply));
-    }
-
-    dbus_message_unref(reply);
-  }
-
-  g_free(path);
+  return ofono_iface_register(path, OFONO_IFACE_CONTEXTS, cb, user_data);
+}
 
-  OFONO_EXIT
+void
+ofono_conn_contexts_close(const char *path, ofono_notify_fn cb,
+                          gpointer user_data)
+{
+  ofono_iface_close(path, OFONO_IFACE_CONTEXTS, cb, user_data);
 }
 
-static gboolean
-ofono_conn_init(const char *path)
+/**
+ * @brief Sends GetContexts. The call is cancelled when the last
+ * #ofono_conn_contexts_register subscriber of the modem is closed, it is
+ * counted by #ofono_iface_fetch_pending until @a cb returns.
+ *
+ * @param path Modem object path
+ * @param cb Called exactly once, with the reply or NULL if cancelled
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE if the call was sent, @a cb is not called otherwise
+ */
+gboolean
+ofono_conn_get_contexts(const char *path, ofono_iface_reply_fn cb,
+                        gpointer user_data)
 {
   DBusMessage *message;
   gboolean rv = FALSE;
-  OFONO_ENTER
 
   message = dbus_message_new_method_call(OFONO_SERVICE, path,
                                          OFONO_CONNECTION_MANAGER_INTERFACE,
-                                         "GetProperties");
+                                         "GetContexts");
 
   if (message)
   {
-    gchar *_path = g_strdup(path);
+    rv = ofono_iface_fetch_call(OFONO_IFACE_CONTEXTS, message, cb,
+                                user_data);
 
-    if (icd_dbus_send_system_mcall(message, -1, ofono_conn_get_properties_cb,
-                                   _path))
-    {
-      rv = TRUE;
-    }
-    else
-    {
-      g_free(_path);
-      OFONO_ERR("could not send 'GetProperties' message");
-    }
+    if (!rv)
+      OFONO_ERR("could not send 'GetContexts' message");
 
     dbus_message_unref(message);
   }
   else
-    OFONO_ERR("could not create 'GetProperties' method call");
-
-  OFONO_EXIT
+    OFONO_ERR("could not create 'GetContexts' method call");
 
   return rv;
 }
-
-static DBusHandlerResult
-ofono_conn_filter(DBusConnection *connection, DBusMessage *message,
-                  void *user_data)
-{
-  OFONO_ENTER
-
-  if (dbus_message_is_signal(message, OFONO_CONNECTION_MANAGER_INTERFACE,
-                             "PropertyChanged"))
-  {
-    DBusMessageIter iter;
-
-    if (dbus_message_iter_init(message, &iter))
-      ofono_conn_property_changed(dbus_message_get_path(message), &iter);
-    else
-      OFONO_WARN("Invalid arguments for PropertyChanged signal");
-  }
-
-  OFONO_EXIT
-
-  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-}
-
-static gboolean
-ofono_conn_add_dbus_filter()
-{
-  return icd_dbus_connect_system_bcast_signal(
-        OFONO_CONNECTION_MANAGER_INTERFACE, ofono_conn_filter, NULL, NULL);
-}
-
-static void
-ofono_conn_remove_dbus_filter()
-{
-  icd_dbus_disconnect_system_bcast_signal(
-    OFONO_CONNECTION_MANAGER_INTERFACE, ofono_conn_filter, NULL, NULL);
-}
-
-gboolean
-ofono_conn_register(const char *path, ofono_notify_fn cb, gpointer user_data)
-{
-  gboolean rv = TRUE;
-  GSList *notifiers;
-
-  if (!conns)
-    conns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-
-  notifiers = g_hash_table_lookup(conns, path);
-
-  if (!notifiers)
-  {
-    if ((rv = ofono_conn_init(path)))
-        rv = ofono_conn_add_dbus_filter();
-  }
-
-  if (rv)
-  {
-    ofono_notifier_register(&notifiers, cb, user_data);
-    g_hash_table_insert(conns, g_strdup(path), notifiers);
-  }
-
-  return rv;
-}
-
-void
-ofono_conn_close(const char *path, ofono_notify_fn cb, gpointer user_data)
-{
-  GSList *notifiers;
-
-  if (!conns)
-      return;
-
-  notifiers = g_hash_table_lookup(conns, path);
-
-  if (notifiers)
-  {
-    ofono_notifier_close(&notifiers, cb, user_data);
-
-    if (!notifiers)
-    {
-      g_hash_table_remove(conns, path);
-
-      if (!g_hash_table_size(conns))
-      {
-        ofono_conn_remove_dbus_filter();
-        g_hash_table_unref(conns);
-        conns = NULL;
-      }
-    }
-    else
-      g_hash_table_insert(conns, g_strdup(path), notifiers);
-  }
-}
@@ -1,5 +1,10 @@
 #include <ofono/dbus.h>
 #include "notifier.h"
+#include "ofono-iface.h"
 
 gboolean ofono_conn_register(const char *path, ofono_notify_fn cb, gpointer user_data);
 void ofono_conn_close(const char *path, ofono_notify_fn cb, gpointer user_data);
+
+gboolean ofono_conn_contexts_register(const char *path, ofono_notify_fn cb, gpointer user_data);
+void ofono_conn_contexts_close(const char *path, ofono_notify_fn cb, gpointer user_data);
+gboolean ofono_conn_get_contexts(const char *path, ofono_iface_reply_fn cb, gpointer user_data);
@@ -0,0 +1,249 @@
+#include <glib.h>
+
+#include <string.h>
+
+#include "ofono-context.h"
+#include "ofono-iface.h"
+#include "dbus-helpers.h"
+#include "property.h"
+#include "log.h"
+
+static gchar **
+ofono_context_read_strv(DBusMessageIter *variant)
+{
+  GPtrArray *strv = g_ptr_array_new();
+  DBusMessageIter array_iter;
+
+  dbus_message_iter_recurse(variant, &array_iter);
+
+  while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRING)
+  {
+    const char *s;
+
+    dbus_message_iter_get_basic(&array_iter, &s);
+    g_ptr_array_add(strv, g_strdup(s));
+    dbus_message_iter_next(&array_iter);
+  }
+
+  g_ptr_array_add(strv, NULL);
+
+  return (gchar **)g_ptr_array_free(strv, FALSE);
+}
+
+static gboolean
+ofono_context_strv_equal(gchar **a, gchar **b)
+{
+  if (!a || !b)
+    return a == b;
+
+  for (; *a && *b; a++, b++)
+  {
+    if (strcmp(*a, *b))
+      return FALSE;
+  }
+
+  return !*a && !*b;
+}
+
+static gboolean
+ofono_context_settings_equal(const modem_context_settings *a,
+                             const modem_context_settings *b)
+{
+  return !g_strcmp0(a->interface, b->interface) &&
+      !g_strcmp0(a->method, b->method) &&
+      !g_strcmp0(a->address, b->address) &&
+      !g_strcmp0(a->netmask, b->netmask) &&
+      a->prefix_length == b->prefix_length &&
+      !g_strcmp0(a->gateway, b->gateway) &&
+      ofono_context_strv_equal(a->dns, b->dns);
+}
+
+/* stores a single dictionary entry, entries that are not tracked or have an
+ * unexpected type are skipped */
+static void
+ofono_context_read_setting(DBusMessageIter *dict_iter,
+                           modem_context_settings *settings)
+{
+  const property_desc *desc;
+  DBusMessageIter value;
+  const char *key;
+  gpointer field;
+
+  if (dbus_message_iter_get_arg_type(dict_iter) != DBUS_TYPE_STRING)
+    return;
+
+  dbus_message_iter_get_basic(dict_iter, &key);
+  dbus_message_iter_next(dict_iter);
+
+  if (dbus_message_iter_get_arg_type(dict_iter) != DBUS_TYPE_VARIANT ||
+      !(desc = property_lookup_setting(key)))
+  {
+    return;
+  }
+
+  dbus_message_iter_recurse(dict_iter, &value);
+
+  if (dbus_message_iter_get_arg_type(&value) != desc->dbus_type)
+  {
+    OFONO_WARN("Unexpected type '%c' of setting %s",
+               dbus_message_iter_get_arg_type(&value), key);
+    return;
+  }
+
+  field = G_STRUCT_MEMBER_P(settings, desc->offset);
+
+  switch (desc->type)
+  {
+    case PROPERTY_TYPE_STRING:
+    {
+      const char *s;
+
+      dbus_message_iter_get_basic(&value, &s);
+      g_free(*(gchar **)field);
+      *(gchar **)field = g_strdup(s);
+      break;
+    }
+    case PROPERTY_TYPE_UINT8:
+      dbus_message_iter_get_basic(&value, field);
+      break;
+    case PROPERTY_TYPE_STRV:
+      if (dbus_message_iter_get_element_type(&value) != DBUS_TYPE_STRING)
+      {
+        OFONO_WARN("Unexpected element type of setting %s", key);
+        break;
+      }
+
+      g_strfreev(*(gchar ***)field);
+      *(gchar ***)field = ofono_context_read_strv(&value);
+      break;
+    default:
+      break;
+  }
+}
+
+/* oFono always sends the whole dictionary, an empty one once inactive */
+static gboolean
+ofono_context_read_settings(DBusMessageIter *variant,
+                            modem_context_settings *settings)
+{
+  modem_context_settings new_settings = {0};
+  DBusMessageIter array_iter;
+
+  dbus_message_iter_recurse(variant, &array_iter);
+
+  while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_DICT_ENTRY)
+  {
+    DBusMessageIter dict_iter;
+
+    dbus_message_iter_recurse(&array_iter, &dict_iter);
+    ofono_context_read_setting(&dict_iter, &new_settings);
+    dbus_message_iter_next(&array_iter);
+  }
+
+  if (ofono_context_settings_equal(settings, &new_settings))
+  {
+    modem_context_settings_clear(&new_settings);
+    return FALSE;
+  }
+
+  modem_context_settings_clear(settings);
+  *settings = new_settings;
+
+  return TRUE;
+}
+
+/**
+ * @brief Stores a single org.ofono.ConnectionContext property in a context
+ * record
+ *
+ * @param iter Iterator pointing to the property name, followed by the
+ * variant value
+ * @param context Context being modified
+ *
+ * @return OFONO_MODEM_CHANGED_CONTEXT_* bit of the property if the context
+ * got a new value, 0 otherwise
+ */
+guint64
+ofono_context_read_property(DBusMessageIter *iter, modem_context *context)
+{
+  const property_desc *desc;
+  property_changed pc = {0};
+  DBusMessageIter variant;
+
+  pc.path = context->path;
+  pc.type = dbus_helper_read_basic_property(iter, &pc.property, &pc.val);
+
+  if (pc.type == DBUS_TYPE_INVALID ||
+      !(desc = property_lookup(OFONO_IFACE_CONTEXT, pc.property)))
+  {
+    return 0;
+  }
+
+  if (desc->type != PROPERTY_TYPE_SETTINGS)
+    return property_update_context(context, &pc);
+
+  /* dbus_helper_read_basic_property() left iter at the variant */
+  dbus_message_iter_recurse(iter, &variant);
+
+  if (pc.type != desc->dbus_type ||
+      dbus_message_iter_get_element_type(&variant) != DBUS_TYPE_DICT_ENTRY)
+  {
+    OFONO_WARN("Unexpected type '%c' of property %s", pc.type, desc->name);
+    return 0;
+  }
+
+  if (ofono_context_read_settings(&variant,
+                                  G_STRUCT_MEMBER_P(context, desc->offset)))
+  {
+    return desc->changed;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Stores all properties of a dictionary in a context record, as sent
+ * by GetContexts and ContextAdded
+ *
+ * @param iter Iterator pointing to the a{sv} dictionary
+ * @param context Context being modified
+ *
+ * @return OFONO_MODEM_CHANGED_CONTEXT_* mask of the properties that got a new
+ * value
+ */
+guint64
+ofono_context_read_properties(DBusMessageIter *iter, modem_context *context)
+{
+  DBusMessageIter array_iter;
+  guint64 changed = 0;
+
+  if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+    return 0;
+
+  dbus_message_iter_recurse(iter, &array_iter);
+
+  while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_DICT_ENTRY)
+  {
+    DBusMessageIter dict_iter;
+
+    dbus_message_iter_recurse(&array_iter, &dict_iter);
+
+    changed |= ofono_context_read_property(&dict_iter, context);
+
+    dbus_message_iter_next(&array_iter);
+  }
+
+  return changed;
+}
+
+gboolean
+ofono_context_watch(const char *path, ofono_notify_fn cb, gpointer user_data)
+{
+  return ofono_iface_watch(path, OFONO_IFACE_CONTEXT, cb, user_data);
+}
+
+void
+ofono_context_close(const char *path, ofono_notify_fn cb, gpointer user_data)
+{
+  ofono_iface_close(path, OFONO_IFACE_CONTEXT, cb, user_data);
+}
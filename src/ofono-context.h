@@ -0,0 +1,9 @@
+#include <ofono/dbus.h>
+#include "notifier.h"
+#include "modem.h"
+
+guint64 ofono_context_read_property(DBusMessageIter *iter, modem_context *context);
+guint64 ofono_context_read_properties(DBusMessageIter *iter, modem_context *context);
+
+gboolean ofono_context_watch(const char *path, ofono_notify_fn cb, gpointer user_data);
+void ofono_context_close(const char *path, ofono_notify_fn cb, gpointer user_data);
@@ -0,0 +1,363 @@
+#include <glib.h>
+#include <dbus/dbus-glib-lowlevel.h>
+#include <icd/support/icd_dbus.h>
+
+#include "ofono-engine.h"
+#include "log.h"
+
+/* Everything that tracks oFono runs on the engine context. By default that is
+ * the default main context and the system bus connection of icd2, so calls
+ * and notifications are plain function calls. With ofono_engine_start() the
+ * engine gets its own context, thread and bus connection; consumers call in
+ * with ofono_engine_call() and get their notifications back on their own
+ * context through ofono_engine_post(). */
+
+struct _engine_event
+{
+  struct _engine_event *next;
+  ofono_engine_fn fn;
+  gpointer data;
+};
+
+typedef struct _engine_event engine_event;
+
+struct _engine_call
+{
+  ofono_engine_fn fn;
+  gpointer data;
+  gboolean done;
+};
+
+typedef struct _engine_call engine_call;
+
+/* all NULL unless the engine runs in its own thread */
+static GThread *engine_thread = NULL;
+static GMainContext *engine_context = NULL;
+static GMainLoop *engine_loop = NULL;
+static DBusConnection *engine_connection = NULL;
+static GMainContext *notify_context = NULL;
+
+/* events for notify_context, newest first */
+static engine_event *events = NULL;
+static gint events_scheduled = FALSE;
+
+static GMutex call_lock;
+static GCond call_cond;
+
+static gpointer
+ofono_engine_thread(gpointer data)
+{
+  g_main_context_push_thread_default(engine_context);
+  g_main_loop_run(engine_loop);
+  g_main_context_pop_thread_default(engine_context);
+
+  return NULL;
+}
+
+static void
+ofono_engine_cleanup()
+{
+  if (engine_connection)
+  {
+    dbus_connection_close(engine_connection);
+    dbus_connection_unref(engine_connection);
+    engine_connection = NULL;
+  }
+
+  if (engine_loop)
+  {
+    g_main_loop_unref(engine_loop);
+    engine_loop = NULL;
+  }
+
+  if (engine_context)
+  {
+    g_main_context_unref(engine_context);
+    engine_context = NULL;
+  }
+}
+
+/* Runs the events in the order they were posted. The flag is cleared before
+ * the queue is taken, so an event posted meanwhile schedules a new run. */
+static gboolean
+ofono_engine_dispatch(gpointer user_data)
+{
+  engine_event *list;
+  engine_event *fifo = NULL;
+
+  g_atomic_int_set(&events_scheduled, FALSE);
+
+  do
+    list = g_atomic_pointer_get(&events);
+  while (!g_atomic_pointer_compare_and_exchange(&events, list, NULL));
+
+  while (list)
+  {
+    engine_event *e = list;
+
+    list = e->next;
+    e->next = fifo;
+    fifo = e;
+  }
+
+  while (fifo)
+  {
+    engine_event *e = fifo;
+
+    fifo = e->next;
+    e->fn(e->data);
+    g_free(e);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * @brief Moves the engine to a new thread with its own main context and a
+ * private system bus connection. Must be called while nothing is tracked.
+ *
+ * @param context Context to deliver notifications on, NULL for the thread
+ * default context of the caller
+ * @param error Return location for the error or NULL
+ *
+ * @return TRUE on success
+ */
+gboolean
+ofono_engine_start(GMainContext *context, GError **error)
+{
+  DBusError dbus_error;
+
+  if (engine_thread)
+    return TRUE;
+
+  /* the private connection is used from another thread than icd2's */
+  dbus_threads_init_default();
+  dbus_error_init(&dbus_error);
+  engine_connection = dbus_bus_get_private(DBUS_BUS_SYSTEM, &dbus_error);
+
+  if (!engine_connection)
+  {
+    OFONO_ERR("could not connect to the system bus: %s", dbus_error.message);
+    g_dbus_error_set_dbus_error(error, dbus_error.name, dbus_error.message,
+                                NULL);
+    dbus_error_free(&dbus_error);
+    return FALSE;
+  }
+
+  dbus_connection_set_exit_on_disconnect(engine_connection, FALSE);
+
+  engine_context = g_main_context_new();
+  engine_loop = g_main_loop_new(engine_context, FALSE);
+  dbus_connection_setup_with_g_main(engine_connection, engine_context);
+
+  if (context)
+    notify_context = g_main_context_ref(context);
+  else
+    notify_context = g_main_context_ref_thread_default();
+
+  engine_thread = g_thread_try_new("ofono", ofono_engine_thread, NULL, error);
+
+  if (!engine_thread)
+  {
+    OFONO_ERR("could not start the engine thread");
+    ofono_engine_cleanup();
+    g_main_context_unref(notify_context);
+    notify_context = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Stops the engine thread, the engine runs on the default main context
+ * again. Notifications posted before are delivered before this returns. Must
+ * be called from the notification context while nothing is tracked.
+ */
+void
+ofono_engine_stop(void)
+{
+  GMainContext *context = notify_context;
+
+  if (!engine_thread)
+    return;
+
+  g_main_loop_quit(engine_loop);
+  g_thread_join(engine_thread);
+  engine_thread = NULL;
+
+  ofono_engine_cleanup();
+
+  notify_context = NULL;
+  ofono_engine_dispatch(NULL);
+  g_main_context_unref(context);
+}
+
+gboolean
+ofono_engine_is_threaded(void)
+{
+  return engine_thread != NULL;
+}
+
+/**
+ * @brief Gets the bus connection of the engine
+ *
+ * @return The private connection of the engine thread or the system bus
+ * connection of icd2
+ */
+DBusConnection *
+ofono_engine_get_connection(void)
+{
+  if (engine_connection)
+    return engine_connection;
+
+  return icd_dbus_get_system_bus();
+}
+
+/**
+ * @brief Gets the main context the engine runs on
+ *
+ * @return The context of the engine thread, NULL for the default context
+ */
+GMainContext *
+ofono_engine_get_context(void)
+{
+  return engine_context;
+}
+
+/**
+ * @brief Gets the main context notifications are delivered on
+ *
+ * @return The notification context, NULL for the default context
+ */
+GMainContext *
+ofono_engine_get_notify_context(void)
+{
+  return notify_context;
+}
+
+/**
+ * @brief Same as g_idle_add(), but on the engine context
+ */
+guint
+ofono_engine_idle_add(GSourceFunc func, gpointer data)
+{
+  GSource *source = g_idle_source_new();
+  guint id;
+
+  g_source_set_callback(source, func, data, NULL);
+  id = g_source_attach(source, engine_context);
+  g_source_unref(source);
+
+  return id;
+}
+
+/**
+ * @brief Same as g_timeout_add(), but on the engine context
+ */
+guint
+ofono_engine_timeout_add(guint interval, GSourceFunc func, gpointer data)
+{
+  GSource *source = g_timeout_source_new(interval);
+  guint id;
+
+  g_source_set_callback(source, func, data, NULL);
+  id = g_source_attach(source, engine_context);
+  g_source_unref(source);
+
+  return id;
+}
+
+/**
+ * @brief Same as g_source_remove(), for sources of #ofono_engine_idle_add and
+ * #ofono_engine_timeout_add
+ */
+void
+ofono_engine_source_remove(guint id)
+{
+  GSource *source = g_main_context_find_source_by_id(engine_context, id);
+
+  if (source)
+    g_source_destroy(source);
+}
+
+static gboolean
+ofono_engine_call_cb(gpointer user_data)
+{
+  engine_call *call = user_data;
+
+  call->fn(call->data);
+
+  g_mutex_lock(&call_lock);
+  call->done = TRUE;
+  g_cond_broadcast(&call_cond);
+  g_mutex_unlock(&call_lock);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * @brief Runs a function on the engine context and waits until it returns.
+ * Without an engine thread, or from the engine thread, the function is called
+ * directly.
+ *
+ * @param fn Function
+ * @param data Data passed to @a fn
+ */
+void
+ofono_engine_call(ofono_engine_fn fn, gpointer data)
+{
+  engine_call call = {fn, data, FALSE};
+
+  if (!engine_thread || g_thread_self() == engine_thread)
+  {
+    fn(data);
+    return;
+  }
+
+  g_main_context_invoke(engine_context, ofono_engine_call_cb, &call);
+
+  g_mutex_lock(&call_lock);
+
+  while (!call.done)
+    g_cond_wait(&call_cond, &call_lock);
+
+  g_mutex_unlock(&call_lock);
+}
+
+/**
+ * @brief Hands a function over to the notification context. Without an
+ * engine thread the function is called directly. The queue is a lock-free
+ * stack; only the first event of a batch wakes the notification context up.
+ *
+ * @param fn Function, called once
+ * @param data Data passed to @a fn
+ */
+void
+ofono_engine_post(ofono_engine_fn fn, gpointer data)
+{
+  engine_event *e;
+
+  if (!notify_context)
+  {
+    fn(data);
+    return;
+  }
+
+  e = g_new(engine_event, 1);
+  e->fn = fn;
+  e->data = data;
+
+  do
+    e->next = g_atomic_pointer_get(&events);
+  while (!g_atomic_pointer_compare_and_exchange(&events, e->next, e));
+
+  if (g_atomic_int_compare_and_exchange(&events_scheduled, FALSE, TRUE))
+  {
+    GSource *source = g_idle_source_new();
+
+    g_source_set_callback(source, ofono_engine_dispatch, NULL, NULL);
+    g_source_attach(source, notify_context);
+    g_source_unref(source);
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef __ICD_OFONO_ENGINE_H__
+#define __ICD_OFONO_ENGINE_H__
+
+#include <gio/gio.h>
+#include <dbus/dbus.h>
+
+typedef void (*ofono_engine_fn)(gpointer data);
+
+gboolean ofono_engine_start(GMainContext *notify_context, GError **error);
+void ofono_engine_stop(void);
+gboolean ofono_engine_is_threaded(void);
+
+DBusConnection *ofono_engine_get_connection(void);
+GMainContext *ofono_engine_get_context(void);
+GMainContext *ofono_engine_get_notify_context(void);
+guint ofono_engine_idle_add(GSourceFunc func, gpointer data);
+guint ofono_engine_timeout_add(guint interval, GSourceFunc func, gpointer data);
+void ofono_engine_source_remove(guint id);
+
+void ofono_engine_call(ofono_engine_fn fn, gpointer data);
+void ofono_engine_post(ofono_engine_fn fn, gpointer data);
+
+#endif /* __ICD_OFONO_ENGINE_H__ */
@@ -0,0 +1,976 @@
+#include <glib.h>
+
+#include <string.h>
+
+#include "ofono-iface.h"
+#include "ofono-engine.h"
+#include "string-pool.h"
+#include "ofono-modem.h"
+#include "log.h"
+#include "dbus-helpers.h"
+#include "modem.h"
+
+typedef int (*ofono_iface_read_fn)(DBusMessageIter *iter, property_changed *pc);
+
+struct _iface_desc
+{
+  /** D-Bus interface name */
+  const char *name;
+  /** NULL terminated list of signals to subscribe to */
+  const char *const *members;
+  /** property decoder, NULL for interfaces without properties */
+  ofono_iface_read_fn read_property;
+};
+
+typedef struct _iface_desc iface_desc;
+
+/** @brief All watchers registered on a single oFono object path */
+struct _iface_object
+{
+  /** pooled */
+  const gchar *path;
+  ofono_notifier_list *notifiers[OFONO_IFACE_LAST];
+  /** method calls waiting for a reply, cancelled with the last notifier */
+  GSList *calls[OFONO_IFACE_LAST];
+  /** SetProperty calls without arguments, copied for every write */
+  DBusMessage *set_property[OFONO_IFACE_LAST];
+};
+
+typedef struct _iface_object iface_object;
+
+struct _iface_call
+{
+  DBusPendingCall *pending;
+  iface_object *obj;
+  ofono_iface_type type;
+  ofono_iface_reply_fn cb;
+  gpointer user_data;
+  /** counted in fetches_pending until @a cb returns */
+  gboolean fetch;
+};
+
+typedef struct _iface_call iface_call;
+
+struct _get_properties_data
+{
+  /** pooled */
+  const gchar *path;
+  ofono_iface_type type;
+  /** task to complete, NULL for the initial fetch */
+  GTask *task;
+};
+
+typedef struct _get_properties_data get_properties_data;
+
+static int ofono_iface_read_basic_property(DBusMessageIter *iter,
+                                           property_changed *pc);
+static iface_object *ofono_iface_object_find(const char *path);
+
+static const char *const manager_members[] =
+{
+  "ModemAdded",
+  "ModemRemoved",
+  NULL
+};
+
+static const char *const property_members[] =
+{
+  "PropertyChanged",
+  NULL
+};
+
+static const char *const contexts_members[] =
+{
+  "ContextAdded",
+  "ContextRemoved",
+  NULL
+};
+
+static const iface_desc ifaces[OFONO_IFACE_LAST] =
+{
+  [OFONO_IFACE_MANAGER] = {OFONO_MANAGER_INTERFACE, manager_members, NULL},
+  [OFONO_IFACE_MODEM] = {OFONO_MODEM_INTERFACE, property_members,
+                         ofono_modem_read_property},
+  [OFONO_IFACE_SIM] = {OFONO_SIM_MANAGER_INTERFACE, property_members,
+                       ofono_iface_read_basic_property},
+  [OFONO_IFACE_NET] = {OFONO_NETWORK_REGISTRATION_INTERFACE, property_members,
+                       ofono_iface_read_basic_property},
+  [OFONO_IFACE_CONN] = {OFONO_CONNECTION_MANAGER_INTERFACE, property_members,
+                        ofono_iface_read_basic_property},
+  [OFONO_IFACE_CONTEXTS] = {OFONO_CONNECTION_MANAGER_INTERFACE,
+                            contexts_members, NULL},
+  [OFONO_IFACE_CONTEXT] = {OFONO_CONNECTION_CONTEXT_INTERFACE,
+                           property_members, NULL},
+  [OFONO_IFACE_LTE] = {OFONO_LTE_INTERFACE, property_members,
+                       ofono_iface_read_basic_property}
+};
+
+/* pooled object path -> iface_object, hashed by pointer */
+static GHashTable *objects = NULL;
+
+/* interfaces with a path-less match rule, see ofono_iface_watch_all() */
+static gboolean watched_all[OFONO_IFACE_LAST] = {FALSE};
+
+/* method call timeout in milliseconds, -1 for the D-Bus default */
+static gint call_timeout = -1;
+
+/* initial GetProperties and GetContexts calls in flight */
+static guint fetches_pending = 0;
+static ofono_notifier_list *fetch_notifiers = NULL;
+
+static int
+ofono_iface_read_basic_property(DBusMessageIter *iter, property_changed *pc)
+{
+  int type = dbus_helper_read_basic_property(iter, &pc->property, &pc->val);
+
+  if (!dbus_helper_is_basic_type(type))
+    return DBUS_TYPE_INVALID;
+
+  return type;
+}
+
+/* an interface can be split in several types by signal */
+static ofono_iface_type
+ofono_iface_lookup(const char *name, const char *member)
+{
+  int i;
+
+  if (name && member)
+  {
+    for (i = 0; i < OFONO_IFACE_LAST; i++)
+    {
+      const char *const *m;
+
+      if (strcmp(name, ifaces[i].name))
+        continue;
+
+      for (m = ifaces[i].members; *m; m++)
+      {
+        if (!strcmp(member, *m))
+          return i;
+      }
+    }
+  }
+
+  return OFONO_IFACE_LAST;
+}
+
+/* path must be pooled, notifiers may keep it and close the object */
+static void
+ofono_iface_property_changed(ofono_notifier_list *notifiers,
+                             ofono_iface_type type, const char *path,
+                             DBusMessageIter *iter)
+{
+  property_changed pc;
+
+  if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_STRING)
+    return;
+
+  pc.path = path;
+
+  pc.type = ifaces[type].read_property(iter, &pc);
+
+  if (pc.type != DBUS_TYPE_INVALID)
+    ofono_notifier_notify(notifiers, &pc);
+}
+
+static DBusHandlerResult
+ofono_iface_filter(DBusConnection *connection, DBusMessage *message,
+                   void *user_data)
+{
+  ofono_iface_type type;
+  const char *path;
+  iface_object *obj = NULL;
+
+  if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_SIGNAL)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  type = ofono_iface_lookup(dbus_message_get_interface(message),
+                            dbus_message_get_member(message));
+
+  if (type == OFONO_IFACE_LAST)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  path = dbus_message_get_path(message);
+  obj = ofono_iface_object_find(path);
+
+  if (!obj || !obj->notifiers[type])
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  path = obj->path;
+
+  OFONO_ENTER
+
+  if (!ifaces[type].read_property)
+    ofono_notifier_notify(obj->notifiers[type], message);
+  else if (dbus_message_has_member(message, "PropertyChanged"))
+  {
+    DBusMessageIter iter;
+
+    if (dbus_message_iter_init(message, &iter))
+      ofono_iface_property_changed(obj->notifiers[type], type, path, &iter);
+    else
+      OFONO_WARN("Invalid arguments for PropertyChanged signal");
+  }
+
+  OFONO_EXIT
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void
+ofono_iface_get_properties_cb(DBusMessage *reply, gpointer user_data)
+{
+  get_properties_data *data = user_data;
+  GError *error = NULL;
+
+  OFONO_ENTER
+
+  if (!reply)
+  {
+    OFONO_DEBUG("%s GetProperties cancelled", ifaces[data->type].name);
+    g_set_error_literal(&error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                        "GetProperties cancelled");
+  }
+  else if (data->task &&
+           g_cancellable_set_error_if_cancelled(
+             g_task_get_cancellable(data->task), &error))
+  {
+    OFONO_DEBUG("%s GetProperties cancelled", ifaces[data->type].name);
+  }
+  else if (dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_ERROR)
+  {
+    DBusMessageIter iter;
+
+    dbus_message_iter_init(reply, &iter);
+
+    if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+    {
+      DBusMessageIter array_iter;
+
+      dbus_message_iter_recurse(&iter, &array_iter);
+
+      while (dbus_message_iter_get_arg_type(&array_iter) ==
+             DBUS_TYPE_DICT_ENTRY)
+      {
+        DBusMessageIter dict_iter;
+        iface_object *obj;
+
+        /* a notifier might have closed the watch, so lookup every time */
+        obj = objects ? g_hash_table_lookup(objects, data->path) : NULL;
+
+        if (!obj || !obj->notifiers[data->type])
+          break;
+
+        dbus_message_iter_recurse(&array_iter, &dict_iter);
+        ofono_iface_property_changed(obj->notifiers[data->type], data->type,
+                                     data->path, &dict_iter);
+
+        dbus_message_iter_next(&array_iter);
+      }
+    }
+    else
+    {
+      g_set_error(&error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                  "Unexpected argument type in %s GetProperties reply",
+                  ifaces[data->type].name);
+    }
+  }
+  else
+  {
+    OFONO_WARN("%s GetProperties returned '%s'", ifaces[data->type].name,
+               dbus_message_get_error_name(reply));
+    dbus_helper_set_error(&error, reply);
+  }
+
+  if (data->task)
+  {
+    if (error)
+      g_task_return_error(data->task, error);
+    else
+      g_task_return_boolean(data->task, TRUE);
+
+    g_object_unref(data->task);
+  }
+  else if (error)
+    g_error_free(error);
+
+  g_free(data);
+
+  OFONO_EXIT
+}
+
+static gboolean
+ofono_iface_get_properties(const char *path, ofono_iface_type type,
+                           GTask *task)
+{
+  DBusMessage *message;
+  gboolean rv = FALSE;
+
+  OFONO_ENTER
+
+  message = dbus_message_new_method_call(OFONO_SERVICE, path,
+                                         ifaces[type].name, "GetProperties");
+
+  if (message)
+  {
+    get_properties_data *data = g_new(get_properties_data, 1);
+
+    data->path = string_pool_intern(path);
+    data->type = type;
+    data->task = task;
+
+    if (ofono_iface_fetch_call(type, message, ofono_iface_get_properties_cb,
+                               data))
+    {
+      rv = TRUE;
+    }
+    else
+    {
+      g_free(data);
+      OFONO_ERR("could not send 'GetProperties' message");
+    }
+
+    dbus_message_unref(message);
+  }
+  else
+    OFONO_ERR("could not create 'GetProperties' method call");
+
+  OFONO_EXIT
+
+  return rv;
+}
+
+/* NULL path matches the interface on all objects */
+static gchar *
+ofono_iface_match_rule(const char *path, ofono_iface_type type,
+                       const char *member)
+{
+  if (!path)
+  {
+    return g_strdup_printf(
+          "type='signal',sender='%s',interface='%s',member='%s'",
+          OFONO_SERVICE, ifaces[type].name, member);
+  }
+
+  return g_strdup_printf(
+        "type='signal',sender='%s',path='%s',interface='%s',member='%s'",
+        OFONO_SERVICE, path, ifaces[type].name, member);
+}
+
+/* match rules are added without waiting for the bus daemon to reply, any
+ * error is reported asynchronously and ignored */
+static gboolean
+ofono_iface_add_match(const char *path, ofono_iface_type type)
+{
+  DBusConnection *connection = ofono_engine_get_connection();
+  const char *const *member;
+
+  if (!connection)
+    return FALSE;
+
+  for (member = ifaces[type].members; *member; member++)
+  {
+    gchar *rule = ofono_iface_match_rule(path, type, *member);
+
+    dbus_bus_add_match(connection, rule, NULL);
+    g_free(rule);
+  }
+
+  return TRUE;
+}
+
+static void
+ofono_iface_remove_match(const char *path, ofono_iface_type type)
+{
+  DBusConnection *connection = ofono_engine_get_connection();
+  const char *const *member;
+
+  if (!connection)
+    return;
+
+  for (member = ifaces[type].members; *member; member++)
+  {
+    gchar *rule = ofono_iface_match_rule(path, type, *member);
+
+    dbus_bus_remove_match(connection, rule, NULL);
+    g_free(rule);
+  }
+}
+
+/* the path-less rule of an interface covers every object, the bus would
+ * deliver each signal once more for a rule of the object */
+static gboolean
+ofono_iface_add_path_match(const char *path, ofono_iface_type type)
+{
+  if (watched_all[type])
+    return TRUE;
+
+  return ofono_iface_add_match(path, type);
+}
+
+static void
+ofono_iface_remove_path_match(const char *path, ofono_iface_type type)
+{
+  if (!watched_all[type])
+    ofono_iface_remove_match(path, type);
+}
+
+/* adds or removes the rules of every object the interface is watched on */
+static void
+ofono_iface_update_path_matches(ofono_iface_type type, gboolean add)
+{
+  GHashTableIter iter;
+  gpointer obj;
+
+  if (!objects)
+    return;
+
+  g_hash_table_iter_init(&iter, objects);
+
+  while (g_hash_table_iter_next(&iter, NULL, &obj))
+  {
+    const iface_object *o = obj;
+
+    if (!o->notifiers[type])
+      continue;
+
+    if (add)
+      ofono_iface_add_match(o->path, type);
+    else
+      ofono_iface_remove_match(o->path, type);
+  }
+}
+
+static gboolean
+ofono_iface_add_dbus_filter()
+{
+  DBusConnection *connection = ofono_engine_get_connection();
+
+  if (!connection)
+    return FALSE;
+
+  return dbus_connection_add_filter(connection, ofono_iface_filter, NULL,
+                                    NULL);
+}
+
+static void
+ofono_iface_remove_dbus_filter()
+{
+  DBusConnection *connection = ofono_engine_get_connection();
+
+  if (connection)
+    dbus_connection_remove_filter(connection, ofono_iface_filter, NULL);
+}
+
+static void
+ofono_iface_object_free(gpointer data)
+{
+  iface_object *obj = data;
+  int i;
+
+  for (i = 0; i < OFONO_IFACE_LAST; i++)
+  {
+    ofono_notifier_close(&obj->notifiers[i], NULL, NULL);
+
+    if (obj->set_property[i])
+      dbus_message_unref(obj->set_property[i]);
+  }
+
+  g_free(obj);
+}
+
+static void
+ofono_iface_object_release(iface_object *obj)
+{
+  int i;
+
+  for (i = 0; i < OFONO_IFACE_LAST; i++)
+  {
+    if (obj->notifiers[i] || obj->calls[i])
+      return;
+  }
+
+  g_hash_table_remove(objects, obj->path);
+
+  if (!g_hash_table_size(objects))
+  {
+    ofono_iface_remove_dbus_filter();
+    g_hash_table_unref(objects);
+    objects = NULL;
+  }
+}
+
+/* the object must be released if nothing gets attached to it */
+static iface_object *
+ofono_iface_object_get(const char *path)
+{
+  iface_object *obj;
+
+  if (!objects)
+  {
+    if (!ofono_iface_add_dbus_filter())
+    {
+      OFONO_ERR("could not add D-Bus filter");
+      return NULL;
+    }
+
+    objects = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                    ofono_iface_object_free);
+  }
+
+  path = string_pool_intern(path);
+  obj = g_hash_table_lookup(objects, path);
+
+  if (!obj)
+  {
+    obj = g_new0(iface_object, 1);
+    obj->path = path;
+    g_hash_table_insert(objects, (gpointer)path, obj);
+  }
+
+  return obj;
+}
+
+/* paths that were never pooled cannot have an object */
+static iface_object *
+ofono_iface_object_find(const char *path)
+{
+  if (!objects || !(path = string_pool_lookup(path)))
+    return NULL;
+
+  return g_hash_table_lookup(objects, path);
+}
+
+static void
+ofono_iface_fetch_done(void)
+{
+  if (!--fetches_pending)
+    ofono_notifier_notify(fetch_notifiers, NULL);
+}
+
+static void
+ofono_iface_call_notify(DBusPendingCall *pending, void *user_data)
+{
+  iface_call *call = user_data;
+  iface_object *obj = call->obj;
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+  obj->calls[call->type] = g_slist_remove(obj->calls[call->type], call);
+  ofono_iface_object_release(obj);
+
+  /* libdbus turns a timeout into a NoReply error reply */
+  call->cb(reply, call->user_data);
+
+  if (call->fetch)
+    ofono_iface_fetch_done();
+
+  if (reply)
+    dbus_message_unref(reply);
+
+  /* frees the call */
+  dbus_pending_call_unref(pending);
+}
+
+static void
+ofono_iface_cancel_calls(GSList *calls)
+{
+  while (calls)
+  {
+    iface_call *call = calls->data;
+    gboolean fetch = call->fetch;
+
+    calls = g_slist_delete_link(calls, calls);
+
+    dbus_pending_call_cancel(call->pending);
+    call->cb(NULL, call->user_data);
+
+    /* frees the call */
+    dbus_pending_call_unref(call->pending);
+
+    if (fetch)
+      ofono_iface_fetch_done();
+  }
+}
+
+static gboolean
+ofono_iface_call_full(ofono_iface_type type, DBusMessage *message,
+                      ofono_iface_reply_fn cb, gpointer user_data,
+                      gboolean fetch)
+{
+  DBusConnection *connection = ofono_engine_get_connection();
+  DBusPendingCall *pending = NULL;
+  iface_object *obj;
+  iface_call *call;
+
+  g_return_val_if_fail(type < OFONO_IFACE_LAST, FALSE);
+
+  if (!connection)
+    return FALSE;
+
+  obj = ofono_iface_object_get(dbus_message_get_path(message));
+
+  if (!obj)
+    return FALSE;
+
+  /* sent directly instead of icd_dbus_send_system_mcall() so that the call
+   * data has a destroy notify for cancelled calls */
+  if (!dbus_connection_send_with_reply(connection, message, &pending,
+                                       call_timeout) || !pending)
+  {
+    ofono_iface_object_release(obj);
+    return FALSE;
+  }
+
+  call = g_new(iface_call, 1);
+  call->pending = pending;
+  call->obj = obj;
+  call->type = type;
+  call->cb = cb;
+  call->user_data = user_data;
+  call->fetch = fetch;
+
+  if (!dbus_pending_call_set_notify(pending, ofono_iface_call_notify, call,
+                                    g_free))
+  {
+    dbus_pending_call_cancel(pending);
+    dbus_pending_call_unref(pending);
+    g_free(call);
+    ofono_iface_object_release(obj);
+    return FALSE;
+  }
+
+  obj->calls[type] = g_slist_prepend(obj->calls[type], call);
+
+  if (fetch)
+    fetches_pending++;
+
+  return TRUE;
+}
+
+/**
+ * @brief Sends a method call and tracks it on the (path, interface) pair of
+ * the message until the reply arrives. Calls still in flight when the last
+ * subscriber of the pair closes are cancelled.
+ *
+ * @param type Interface the call is tracked on
+ * @param message Method call, the object path is taken from it
+ * @param cb Called exactly once, with the reply or with NULL if the call was
+ * cancelled
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE if the call was sent, @a cb is not called otherwise
+ */
+gboolean
+ofono_iface_call(ofono_iface_type type, DBusMessage *message,
+                 ofono_iface_reply_fn cb, gpointer user_data)
+{
+  return ofono_iface_call_full(type, message, cb, user_data, FALSE);
+}
+
+/**
+ * @brief Same as #ofono_iface_call, for a call fetching the initial state.
+ * #ofono_iface_fetch_pending stays TRUE until @a cb returns.
+ *
+ * @param type Interface the call is tracked on
+ * @param message Method call, the object path is taken from it
+ * @param cb Called exactly once, with the reply or with NULL if the call was
+ * cancelled
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE if the call was sent, @a cb is not called otherwise
+ */
+gboolean
+ofono_iface_fetch_call(ofono_iface_type type, DBusMessage *message,
+                       ofono_iface_reply_fn cb, gpointer user_data)
+{
+  return ofono_iface_call_full(type, message, cb, user_data, TRUE);
+}
+
+/**
+ * @brief Sets the timeout of the method calls sent from now on
+ *
+ * @param timeout Timeout in milliseconds, -1 for the D-Bus default
+ */
+void
+ofono_iface_set_call_timeout(gint timeout)
+{
+  call_timeout = timeout;
+}
+
+/**
+ * @brief Creates a SetProperty method call without arguments. For objects
+ * that are watched or have calls in flight, it is copied from a message built
+ * once per (path, interface) pair.
+ *
+ * @param path Object path
+ * @param type Interface
+ *
+ * @return New message or NULL
+ */
+DBusMessage *
+ofono_iface_new_set_property(const char *path, ofono_iface_type type)
+{
+  iface_object *obj;
+
+  g_return_val_if_fail(type < OFONO_IFACE_LAST, NULL);
+
+  obj = ofono_iface_object_find(path);
+
+  if (!obj)
+  {
+    return dbus_message_new_method_call(OFONO_SERVICE, path, ifaces[type].name,
+                                        "SetProperty");
+  }
+
+  if (!obj->set_property[type])
+  {
+    obj->set_property[type] = dbus_message_new_method_call(OFONO_SERVICE, path,
+                                                           ifaces[type].name,
+                                                           "SetProperty");
+
+    if (!obj->set_property[type])
+      return NULL;
+  }
+
+  return dbus_message_copy(obj->set_property[type]);
+}
+
+const char *
+ofono_iface_name(ofono_iface_type type)
+{
+  g_return_val_if_fail(type < OFONO_IFACE_LAST, NULL);
+
+  return ifaces[type].name;
+}
+
+static gboolean
+ofono_iface_subscribe(const char *path, ofono_iface_type type, gboolean fetch,
+                      ofono_notify_fn cb, gpointer user_data)
+{
+  iface_object *obj;
+  gboolean rv = TRUE;
+
+  g_return_val_if_fail(type < OFONO_IFACE_LAST, FALSE);
+
+  obj = ofono_iface_object_get(path);
+
+  if (!obj)
+    return FALSE;
+
+  if (!obj->notifiers[type] && (rv = ofono_iface_add_path_match(path, type)))
+  {
+    if (fetch && ifaces[type].read_property &&
+        !(rv = ofono_iface_get_properties(path, type, NULL)))
+    {
+      ofono_iface_remove_path_match(path, type);
+    }
+  }
+
+  if (rv)
+    ofono_notifier_register(&obj->notifiers[type], cb, user_data);
+  else
+    ofono_iface_object_release(obj);
+
+  return rv;
+}
+
+/**
+ * @brief Subscribes to an oFono interface on the given object path. The first
+ * subscriber of a (path, interface) pair fetches the current properties.
+ *
+ * @param path Object path
+ * @param type Interface to watch
+ * @param cb Callback, receives #property_changed for property interfaces or
+ * the #DBusMessage for #OFONO_IFACE_MANAGER
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE on success
+ */
+gboolean
+ofono_iface_register(const char *path, ofono_iface_type type,
+                     ofono_notify_fn cb, gpointer user_data)
+{
+  return ofono_iface_subscribe(path, type, TRUE, cb, user_data);
+}
+
+/**
+ * @brief Same as #ofono_iface_register, but does not fetch the current
+ * properties. To be used when the caller already got them by other means.
+ *
+ * @param path Object path
+ * @param type Interface to watch
+ * @param cb Callback
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE on success
+ */
+gboolean
+ofono_iface_watch(const char *path, ofono_iface_type type, ofono_notify_fn cb,
+                  gpointer user_data)
+{
+  return ofono_iface_subscribe(path, type, FALSE, cb, user_data);
+}
+
+/**
+ * @brief Makes the bus deliver signals of the interface for every object,
+ * including objects that are not registered yet. Signals are still only
+ * routed to registered (path, interface) pairs, which need no match rule of
+ * their own meanwhile.
+ *
+ * @param type Interface
+ *
+ * @return TRUE on success
+ */
+gboolean
+ofono_iface_watch_all(ofono_iface_type type)
+{
+  g_return_val_if_fail(type < OFONO_IFACE_LAST, FALSE);
+
+  if (watched_all[type])
+    return TRUE;
+
+  if (!ofono_iface_add_match(NULL, type))
+    return FALSE;
+
+  watched_all[type] = TRUE;
+  ofono_iface_update_path_matches(type, FALSE);
+
+  return TRUE;
+}
+
+void
+ofono_iface_unwatch_all(ofono_iface_type type)
+{
+  g_return_if_fail(type < OFONO_IFACE_LAST);
+
+  if (!watched_all[type])
+    return;
+
+  /* registered pairs get their rules back before signals stop */
+  watched_all[type] = FALSE;
+  ofono_iface_update_path_matches(type, TRUE);
+  ofono_iface_remove_match(NULL, type);
+}
+
+/**
+ * @brief Removes a subscription made with #ofono_iface_register. Passing NULL
+ * @a cb and @a user_data removes all subscribers of the pair. Calls in flight
+ * on the pair are cancelled when its last subscriber is removed.
+ *
+ * @param path Object path
+ * @param type Watched interface
+ * @param cb Callback
+ * @param user_data User data
+ */
+void
+ofono_iface_close(const char *path, ofono_iface_type type, ofono_notify_fn cb,
+                  gpointer user_data)
+{
+  iface_object *obj;
+
+  g_return_if_fail(type < OFONO_IFACE_LAST);
+
+  obj = ofono_iface_object_find(path);
+
+  if (!obj || !obj->notifiers[type])
+    return;
+
+  ofono_notifier_close(&obj->notifiers[type], cb, user_data);
+
+  if (!obj->notifiers[type])
+  {
+    GSList *calls = obj->calls[type];
+
+    /* callbacks of cancelled calls might close other watches of the object,
+     * so do not touch it after it was released */
+    obj->calls[type] = NULL;
+    ofono_iface_remove_path_match(path, type);
+    ofono_iface_object_release(obj);
+    ofono_iface_cancel_calls(calls);
+  }
+}
+
+/**
+ * @brief Fetches the current properties of an interface and delivers them to
+ * its subscribers, like the initial fetch of #ofono_iface_register does.
+ *
+ * @param path Object path
+ * @param type Interface
+ * @param cancellable A #GCancellable or NULL
+ * @param callback Called when the properties were delivered or on error
+ * @param user_data User data passed to @a callback
+ */
+void
+ofono_iface_fetch_async(const char *path, ofono_iface_type type,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback, gpointer user_data)
+{
+  GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+
+  g_task_set_source_tag(task, ofono_iface_fetch_async);
+  ofono_iface_fetch_task(path, type, task);
+}
+
+/**
+ * @brief Same as #ofono_iface_fetch_async, for a task created by the caller,
+ * e.g. on another thread. Finish it with #ofono_iface_fetch_finish.
+ *
+ * @param path Object path
+ * @param type Interface
+ * @param task Task to complete, its reference is taken over
+ */
+void
+ofono_iface_fetch_task(const char *path, ofono_iface_type type, GTask *task)
+{
+  if (type >= OFONO_IFACE_LAST || !ifaces[type].read_property)
+  {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                            "Interface has no properties");
+    g_object_unref(task);
+  }
+  else if (!ofono_iface_get_properties(path, type, task))
+  {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                            "Could not send GetProperties");
+    g_object_unref(task);
+  }
+}
+
+gboolean
+ofono_iface_fetch_finish(GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+  return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * @brief Tells whether any GetProperties call is still waiting for a reply
+ *
+ * @return TRUE if there are calls in flight
+ */
+gboolean
+ofono_iface_fetch_pending(void)
+{
+  return fetches_pending != 0;
+}
+
+/**
+ * @brief Registers a callback that is called with NULL data every time the
+ * last GetProperties call in flight completes.
+ *
+ * @param cb Callback
+ * @param user_data User data passed to @a cb
+ */
+void
+ofono_iface_fetch_done_register(ofono_notify_fn cb, gpointer user_data)
+{
+  ofono_notifier_register(&fetch_notifiers, cb, user_data);
+}
+
+void
+ofono_iface_fetch_done_close(ofono_notify_fn cb, gpointer user_data)
+{
+  ofono_notifier_close(&fetch_notifiers, cb, user_data);
+}
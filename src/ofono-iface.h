@@ -0,0 +1,57 @@
+#ifndef __ICD_OFONO_IFACE_H__
+#define __ICD_OFONO_IFACE_H__
+
+#include <gio/gio.h>
+#include <ofono/dbus.h>
+#include "notifier.h"
+
+/** @brief oFono D-Bus interfaces the library knows how to watch */
+enum ofono_iface_type
+{
+  /** org.ofono.Manager, watchers receive the raw #DBusMessage signal */
+  OFONO_IFACE_MANAGER,
+  /** org.ofono.Modem */
+  OFONO_IFACE_MODEM,
+  /** org.ofono.SimManager */
+  OFONO_IFACE_SIM,
+  /** org.ofono.NetworkRegistration */
+  OFONO_IFACE_NET,
+  /** org.ofono.ConnectionManager */
+  OFONO_IFACE_CONN,
+  /** ContextAdded and ContextRemoved of org.ofono.ConnectionManager,
+   * watchers receive the raw #DBusMessage signal */
+  OFONO_IFACE_CONTEXTS,
+  /** org.ofono.ConnectionContext, watchers receive the raw #DBusMessage
+   * PropertyChanged signal as settings are dictionaries */
+  OFONO_IFACE_CONTEXT,
+  /** org.ofono.LongTermEvolution */
+  OFONO_IFACE_LTE,
+  OFONO_IFACE_LAST
+};
+
+typedef enum ofono_iface_type ofono_iface_type;
+
+/* reply is NULL if the call was cancelled */
+typedef void (*ofono_iface_reply_fn)(DBusMessage *reply, gpointer user_data);
+
+gboolean ofono_iface_register(const char *path, ofono_iface_type type, ofono_notify_fn cb, gpointer user_data);
+gboolean ofono_iface_watch(const char *path, ofono_iface_type type, ofono_notify_fn cb, gpointer user_data);
+gboolean ofono_iface_watch_all(ofono_iface_type type);
+void ofono_iface_unwatch_all(ofono_iface_type type);
+void ofono_iface_close(const char *path, ofono_iface_type type, ofono_notify_fn cb, gpointer user_data);
+
+gboolean ofono_iface_call(ofono_iface_type type, DBusMessage *message, ofono_iface_reply_fn cb, gpointer user_data);
+gboolean ofono_iface_fetch_call(ofono_iface_type type, DBusMessage *message, ofono_iface_reply_fn cb, gpointer user_data);
+void ofono_iface_set_call_timeout(gint timeout);
+DBusMessage *ofono_iface_new_set_property(const char *path, ofono_iface_type type);
+const char *ofono_iface_name(ofono_iface_type type);
+
+void ofono_iface_fetch_async(const char *path, ofono_iface_type type, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+void ofono_iface_fetch_task(const char *path, ofono_iface_type type, GTask *task);
+gboolean ofono_iface_fetch_finish(GAsyncResult *result, GError **error);
+
+gboolean ofono_iface_fetch_pending(void);
+void ofono_iface_fetch_done_register(ofono_notify_fn cb, gpointer user_data);
+void ofono_iface_fetch_done_close(ofono_notify_fn cb, gpointer user_data);
+
+#endif /* __ICD_OFONO_IFACE_H__ */
@@ -0,0 +1,16 @@
+#include <glib.h>
+
+#include "ofono-lte.h"
+#include "ofono-iface.h"
+
+gboolean
+ofono_lte_register(const char *path, ofono_notify_fn cb, gpointer user_data)
+{
+  return ofono_iface_register(path, OFONO_IFACE_LTE, cb, user_data);
+}
+
+void
+ofono_lte_close(const char *path, ofono_notify_fn cb, gpointer user_data)
+{
+  ofono_iface_close(path, OFONO_IFACE_LTE, cb, user_data);
+}
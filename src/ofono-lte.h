@@ -0,0 +1,5 @@
+#include <ofono/dbus.h>
+#include "notifier.h"
+
+gboolean ofono_lte_register(const char *path, ofono_notify_fn cb, gpointer user_data);
+void ofono_lte_close(const char *path, ofono_notify_fn cb, gpointer user_data);
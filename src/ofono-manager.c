@@ -1,619 +1,2486 @@
 #include <ofono/dbus.h>
 
-#include <string.h>
-
 #include "dbus-helpers.h"
+#include "change-filter.h"
 #include "ofono-manager.h"
+#include "ofono-iface.h"
+#include "property.h"
 #include "ofono-modem.h"
 #include "ofono-sim.h"
 #include "ofono-net.h"
+#include "ofono-conn.h"
+#include "ofono-context.h"
+#include "ofono-lte.h"
+#include "ofono-write.h"
+#include "ofono-engine.h"
+#include "string-pool.h"
 #include "log.h"
 
+/** @brief A change handed over to the notifiers */
+struct _manager_event
+{
+  /** tracking session the change belongs to */
+  guint generation;
+  /** holds a reference of the modem */
+  modem_changed mc;
+};
+
+typedef struct _manager_event manager_event;
+
+struct _manager_ready
+{
+  guint generation;
+  modems_ready result;
+};
+
+typedef struct _manager_ready manager_ready;
+
+/** @brief Snapshot published by the engine, readable from any thread */
+struct _modems_published
+{
+  GHashTable *modems;
+  guint64 version;
+};
+
+typedef struct _modems_published modems_published;
+
+/** @brief Arguments and result of an API call run on the engine context */
+struct _manager_call
+{
+  const char *path;
+  guint64 interface;
+  gint timeout;
+  gboolean enable;
+  guint64 urgent;
+  const property_desc *desc;
+  const change_policy *policy;
+  guint64 field;
+  guint hold;
+  hold_stats *stats;
+  guint generation;
+  GTask *task;
+  GError **error;
+  gboolean rv;
+};
+
+typedef struct _manager_call manager_call;
+
+/** @brief Consumer with its own change policies, registered through
+ * #ofono_manager_consumer_cb */
+struct _manager_consumer
+{
+  ofono_notify_fn cb;
+  gpointer user_data;
+  change_filter *filter;
+};
+
+typedef struct _manager_consumer manager_consumer;
 
-struct _set_property_data
+/** @brief Interfaces a registered callback needs */
+struct _manager_subscription
 {
-  ofono_property_set_fn cb;
+  ofono_notify_fn cb;
   gpointer user_data;
+  /** OFONO_MODEM_INTERFACE_* mask */
+  guint64 interests;
+};
+
+typedef struct _manager_subscription manager_subscription;
+
+/** @brief Boolean field of #modem whose losses can be held back */
+struct _hold_field
+{
+  guint64 changed;
+  glong offset;
+  /** every change of a known value is a flap, not only losing TRUE */
+  gboolean any;
+  /** hold time in milliseconds, 0 to publish losses right away */
+  guint hold;
+  hold_stats stats;
 };
 
-typedef struct _set_property_data set_property_data;
+typedef struct _hold_field hold_field;
+
+/** @brief Property change held back until it lasts longer than the hold
+ * time of the fields it would change */
+struct _hold_pending
+{
+  /** pooled modem path */
+  const gchar *path;
+  ofono_iface_type iface;
+  const property_desc *desc;
+  int type;
+  /** strings are pooled */
+  DBusBasicValue val;
+  /** OFONO_MODEM_CHANGED_* bits of the held fields */
+  guint64 changed;
+  guint id;
+};
 
+typedef struct _hold_pending hold_pending;
+
+/* Consumer side, used from the notification context only. Every tracking
+ * session has its own generation, changes of an earlier one still queued
+ * when the tracking restarts are dropped. */
+static ofono_notifier_list *notifiers = NULL;
+static guint generation = 0;
+static gboolean ready = FALSE;
+static modems_ready ready_result = {FALSE, 0};
+static ofono_notifier_list *ready_notifiers = NULL;
+static GSList *consumers = NULL;
+static GSList *subscriptions = NULL;
+/* union of the interests of all subscriptions */
+static guint64 interests = 0;
+
+/* engine side, used from the engine context only */
 static GHashTable *modems = NULL;
-static GSList *notifiers = NULL;
+static guint engine_generation = 0;
+/* OFONO_MODEM_INTERFACE_* mask of the interfaces watched when present */
+static guint64 watched_interfaces = 0;
+/* whether context signals are received for all contexts */
+static gboolean contexts_watched = FALSE;
+
+/* path -> reference of every modem, built on request after each change */
+static GHashTable *modems_snapshot = NULL;
+static guint64 modems_version = 0;
+
+/* With an engine thread the snapshot is published after every change.
+ * Readers announce themselves before they load the pointer, tables replaced
+ * meanwhile are released once no reader is left. */
+static modems_published *published = NULL;
+static gint published_readers = 0;
+static GSList *published_retired = NULL;
+static gboolean published_dirty = FALSE;
+static guint publish_id = 0;
+
+static gboolean coalesce = FALSE;
+static guint64 coalesce_urgent = OFONO_MODEM_CHANGED_EMERGENCY;
+/* pooled path -> OFONO_MODEM_CHANGED_* mask not yet delivered */
+static GHashTable *pending_changes = NULL;
+static guint pending_changes_id = 0;
+
+/* change policies of all consumers, NULL until one is set */
+static change_filter *policy_filter = NULL;
+
+static hold_field hold_fields[] =
+{
+  {OFONO_MODEM_CHANGED_NET_REGISTERED,
+   G_STRUCT_OFFSET(modem, net.registered), FALSE, 0, {0}},
+  {OFONO_MODEM_CHANGED_NET_ROAMING,
+   G_STRUCT_OFFSET(modem, net.roaming), TRUE, 0, {0}},
+  {OFONO_MODEM_CHANGED_CONN_ATTACHED,
+   G_STRUCT_OFFSET(modem, conn.attached), FALSE, 0, {0}}
+};
+
+/* #hold_pending of every held property */
+static GSList *holds = NULL;
+
+/* startup tracking, see ofono_manager_modems_ready() */
+static gint64 startup_time = 0;
+static gboolean startup_listed = FALSE;
+static gboolean startup_done = FALSE;
+static modems_ready startup_result = {FALSE, 0};
+
+static void ofono_manager_publish();
+static void ofono_manager_hold_drop(const gchar *path,
+                                    ofono_iface_type iface);
 
 static void
-ofono_sim_property_change_cb(gpointer data, gpointer user_data)
+ofono_manager_deliver_change(gpointer data)
 {
-  property_changed *pc = data;
-  modem *m = user_data;
-  const char *property = pc->property;
-  gboolean notify = TRUE;
+  manager_event *e = data;
 
-  OFONO_ENTER
+  if (e->generation == generation)
+    ofono_notifier_notify(notifiers, &e->mc);
 
-  OFONO_DEBUG("SIM property changed %s", property);
+  modem_unref(e->mc.modem);
+  g_free(e);
+}
 
-  if (!strcmp(property, "Present"))
-    m->sim.present = pc->val.bool_val;
-  else if (!strcmp(property, "SubscriberIdentity"))
-  {
-    g_free(m->sim.imsi);
-    m->sim.imsi = g_strdup(pc->val.str);
-  }
-  else if (!strcmp(property, "ServiceProviderName"))
-  {
-    g_free(m->sim.spn);
-    m->sim.spn = g_strdup(pc->val.str);
-  }
-  else
-    notify = FALSE;
+/* without an engine thread the notifiers are called right away */
+static void
+ofono_manager_notify(enum ofono_manager_modem_change type, const modem *m,
+                     guint64 changed)
+{
+  manager_event *e;
 
-  if (notify)
+  if (!ofono_engine_is_threaded())
   {
     modem_changed mc;
 
+    mc.type = type;
     mc.modem = m;
-    mc.type = OFONO_MANAGER_MODEM_CHANGE;
+    mc.changed = changed;
     ofono_notifier_notify(notifiers, &mc);
+    return;
   }
 
-  OFONO_EXIT
+  /* consumers must find the change in the snapshot when they get it */
+  ofono_manager_publish();
+
+  e = g_new(manager_event, 1);
+  e->generation = engine_generation;
+  e->mc.type = type;
+  e->mc.modem = modem_ref(m);
+  e->mc.changed = changed;
+  ofono_engine_post(ofono_manager_deliver_change, e);
 }
 
-static void
-ofono_net_property_change_cb(gpointer data, gpointer user_data)
+static gboolean
+ofono_manager_flush_changes_idle(gpointer user_data)
 {
-  property_changed *pc = data;
-  modem *m = user_data;
-  const char *property = pc->property;
-  gboolean notify = TRUE;
+  GHashTable *pending = pending_changes;
+  GHashTableIter iter;
+  gpointer path, changed;
 
   OFONO_ENTER
 
-  OFONO_DEBUG("NET property changed %s", property);
-
-  if (!strcmp(property, "Status"))
-  {
-    m->net.registered = FALSE;
-    m->net.roaming = FALSE;
+  /* callbacks may queue new changes, they go in a new batch */
+  pending_changes = NULL;
+  pending_changes_id = 0;
 
-    if (!strcmp(pc->val.str, "registered"))
-      m->net.registered = TRUE;
-    else if (!strcmp(pc->val.str, "roaming"))
-    {
-      m->net.registered = TRUE;
-      m->net.roaming = TRUE;
-    }
-  }
-  else if (!strcmp(property, "Name"))
-  {
-    g_free(m->net.name);
-    m->net.name = g_strdup(pc->val.str);
-  }
-  else
-    notify = FALSE;
+  g_hash_table_iter_init(&iter, pending);
 
-  if (notify)
+  while (g_hash_table_iter_next(&iter, &path, &changed))
   {
-    modem_changed mc;
+    /* a callback might have removed the modem */
+    const modem *m = modem_list_find(modems, path);
 
-    mc.modem = m;
-    mc.type = OFONO_MANAGER_MODEM_CHANGE;
-    ofono_notifier_notify(notifiers, &mc);
+    if (m)
+      ofono_manager_notify(OFONO_MANAGER_MODEM_CHANGE, m, *(guint64 *)changed);
   }
 
+  g_hash_table_destroy(pending);
+
   OFONO_EXIT
+
+  return G_SOURCE_REMOVE;
 }
+
 static void
-ofono_modem_property_change_cb(gpointer data, gpointer user_data)
+ofono_manager_drop_changes(const gchar *path)
 {
-  property_changed *pc = data;
-  modem *m = user_data;
-  const char *path = m->path;
-  const char *property = pc->property;
-  gboolean notify = TRUE;
+  if (pending_changes)
+    g_hash_table_remove(pending_changes, path);
 
-  OFONO_ENTER
+  if (policy_filter)
+    change_filter_forget(policy_filter, path);
 
-  OFONO_DEBUG("Modem %s property changed %s", path, property);
+  ofono_manager_hold_drop(path, OFONO_IFACE_LAST);
+}
 
-  if (!strcmp(property, "Powered"))
-    m->powered = pc->val.bool_val;
-  else if (!strcmp(property, "Online"))
-    m->online = pc->val.bool_val;
-  else if (!strcmp(property, "Emergency"))
-    m->emergency_call = pc->val.bool_val;
-  else if (!strcmp(property, "Serial"))
-    m->imei = g_strdup(pc->val.str);
-  else if (!strcmp(property, "Interfaces"))
+static void
+ofono_manager_cancel_changes()
+{
+  if (pending_changes_id)
   {
-    dbus_uint64_t old = m->interfaces;
-    dbus_uint64_t diff = pc->val.u64 ^ old;
-
-    if (diff & OFONO_MODEM_INTERFACE_SIM_MANAGER)
-    {
-      if (old & OFONO_MODEM_INTERFACE_SIM_MANAGER)
-        ofono_sim_close(path, ofono_sim_property_change_cb, m);
-      else
-        ofono_sim_register(path, ofono_sim_property_change_cb, m);
-    }
-
-    if (diff & OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION)
-    {
-      if (old & OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION)
-        ofono_net_close(path, ofono_net_property_change_cb, m);
-      else
-        ofono_net_register(path, ofono_net_property_change_cb, m);
-    }
-
-    m->interfaces = pc->val.u64;
+    ofono_engine_source_remove(pending_changes_id);
+    pending_changes_id = 0;
   }
-  else
-    notify = FALSE;
 
-  if (notify)
+  if (pending_changes)
   {
-    modem_changed mc;
-
-    mc.modem = m;
-    mc.type = OFONO_MANAGER_MODEM_CHANGE;
-    ofono_notifier_notify(notifiers, &mc);
+    g_hash_table_destroy(pending_changes);
+    pending_changes = NULL;
   }
 
-  OFONO_EXIT
+  if (policy_filter)
+    change_filter_reset(policy_filter);
+
+  ofono_manager_hold_drop(NULL, OFONO_IFACE_LAST);
 }
 
+/* path must be pooled, changes passed the policies already */
 static void
-_ofono_manager_add_modem(const gchar *path, gboolean powered)
+ofono_manager_modem_deliver(const gchar *path, guint64 changed)
 {
-  modem *m;
-  modem_changed mc;
+  guint64 *pending = NULL;
+  const modem *m;
 
-  m = modem_list_find(modems, path);
+  if (!changed)
+    return;
 
-  if (!m)
+  if (coalesce)
   {
-    m = modem_new(path, powered);
-    modem_list_add(modems, m);
-    modem_free(m);
+    if (pending_changes)
+      pending = g_hash_table_lookup(pending_changes, path);
 
-    m = modem_list_find(modems, path);
+    if (!(changed & coalesce_urgent))
+    {
+      if (!pending)
+      {
+        if (!pending_changes)
+        {
+          pending_changes = g_hash_table_new_full(g_direct_hash,
+                                                  g_direct_equal, NULL,
+                                                  g_free);
+        }
 
-    mc.type = OFONO_MANAGER_MODEM_ADD;
-    mc.modem = m;
+        pending = g_new0(guint64, 1);
+        g_hash_table_insert(pending_changes, (gpointer)path, pending);
+      }
 
-    ofono_notifier_notify(notifiers, &mc);
+      *pending |= changed;
 
-    ofono_modem_register(path, ofono_modem_property_change_cb, m);
-  }
-  else
-  {
-    mc.modem = m;
-    mc.type = OFONO_MANAGER_MODEM_CHANGE;
-    ofono_notifier_notify(notifiers, &mc);
-  }
+      if (!pending_changes_id)
+      {
+        pending_changes_id = ofono_engine_idle_add(
+              ofono_manager_flush_changes_idle, NULL);
+      }
 
-  if (!powered)
-  {
-    OFONO_INFO("Powering on %s", path);
-    ofono_manager_modem_set_power(path, TRUE, NULL, NULL);
+      return;
+    }
+
+    /* deliver whatever was queued together with the urgent change */
+    if (pending)
+    {
+      changed |= *pending;
+      g_hash_table_remove(pending_changes, path);
+    }
   }
+
+  if ((m = modem_list_find(modems, path)))
+    ofono_manager_notify(OFONO_MANAGER_MODEM_CHANGE, m, changed);
 }
 
-static gboolean
-ofono_manager_modem_read_properties(DBusMessageIter *iter, gboolean *powered)
+static const modem *
+ofono_manager_policy_lookup_cb(const gchar *path, gpointer user_data)
 {
-  DBusMessageIter sub;
-  gboolean rv = FALSE;
-
-  dbus_message_iter_recurse(iter, &sub);
+  const modem *m = modem_list_find(modems, path);
 
-  while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_DICT_ENTRY)
-  {
-    const char *property;
-    DBusBasicValue val;
-    int type = dbus_helper_read_basic_dict_property(&sub, &property, &val);
+  return m ? modem_ref(m) : NULL;
+}
 
-    if (type == DBUS_TYPE_INVALID)
-      continue;
+static void
+ofono_manager_policy_deliver_cb(const modem *m, guint64 changed,
+                                gpointer user_data)
+{
+  ofono_manager_modem_deliver(m->path, changed);
+}
 
-    if (!strcmp(property, "Powered"))
-    {
-      if (type != DBUS_TYPE_BOOLEAN)
-        break;
+/* path must be pooled */
+static void
+ofono_manager_modem_changed(const gchar *path, guint64 changed)
+{
+  const modem *m;
 
-      *powered = val.bool_val;
-      rv = TRUE;
-    }
+  if (!changed)
+    return;
 
-    dbus_message_iter_next(&sub);
-  }
+  if (policy_filter && (m = modem_list_find(modems, path)))
+    changed = change_filter_apply(policy_filter, m, changed);
 
-  return rv;
+  ofono_manager_modem_deliver(path, changed);
 }
 
-static gboolean
-ofono_manager_add_modem(DBusMessageIter *iter)
+static GHashTable *
+ofono_manager_snapshot()
 {
-  gchar *path;
-  gboolean rv = FALSE;
-
-  OFONO_ENTER
-
-  if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_OBJECT_PATH)
+  if (!modems_snapshot)
   {
-    dbus_message_iter_get_basic(iter, &path);
+    GHashTableIter iter;
+    gpointer m;
 
-    dbus_message_iter_next(iter);
+    modems_snapshot = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                            (GDestroyNotify)modem_unref);
+    g_hash_table_iter_init(&iter, modems);
 
-    if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_ARRAY)
+    /* keys are owned by the records */
+    while (g_hash_table_iter_next(&iter, NULL, &m))
     {
-      gboolean powered;
-
-      if (ofono_manager_modem_read_properties(iter, &powered))
-      {
-        _ofono_manager_add_modem(path, powered);
-        rv = TRUE;
-      }
+      g_hash_table_insert(modems_snapshot, ((modem *)m)->path,
+                          (gpointer)modem_ref(m));
     }
   }
-  else
-    OFONO_WARN("Unknown dbus iterator arg type when adding modem");
-
-  OFONO_EXIT
 
-  return rv;
+  return modems_snapshot;
 }
 
 static void
-ofono_manager_get_modems_cb(DBusPendingCall *pending, void *user_data)
+ofono_manager_published_free(gpointer data)
 {
-  DBusMessage *reply;
-  gboolean success = FALSE;
+  modems_published *p = data;
 
-  OFONO_ENTER
+  if (p->modems)
+    g_hash_table_unref(p->modems);
 
-  if (pending)
-  {
-    reply = dbus_pending_call_steal_reply(pending);
-    dbus_pending_call_unref(pending);
-  }
+  g_free(p);
+}
 
-  if (pending && reply)
+static void
+ofono_manager_published_reclaim()
+{
+  if (!g_atomic_int_get(&published_readers))
   {
-    if (dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_ERROR)
-    {
-      DBusMessageIter iter;
+    g_slist_free_full(published_retired, ofono_manager_published_free);
+    published_retired = NULL;
+  }
+}
 
-      dbus_message_iter_init(reply, &iter);
+static void
+ofono_manager_publish()
+{
+  modems_published *p = NULL;
+  modems_published *old;
 
-      if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
-      {
-        DBusMessageIter array_iter;
+  if (publish_id)
+  {
+    ofono_engine_source_remove(publish_id);
+    publish_id = 0;
+  }
 
-        dbus_message_iter_recurse(&iter, &array_iter);
-        success = TRUE;
+  if (!published_dirty)
+    return;
 
-        while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRUCT)
-        {
-          DBusMessageIter struct_iter;
+  published_dirty = FALSE;
 
-          dbus_message_iter_recurse(&array_iter, &struct_iter);
+  if (modems)
+  {
+    p = g_new(modems_published, 1);
+    p->modems = g_hash_table_ref(ofono_manager_snapshot());
+    p->version = modems_version;
+  }
 
-          if (!ofono_manager_add_modem(&struct_iter))
-          {
-            OFONO_WARN("Cannot add modem while processing GetModems reply");
-            success = FALSE;
-            break;
-          }
+  do
+    old = g_atomic_pointer_get(&published);
+  while (!g_atomic_pointer_compare_and_exchange(&published, old, p));
 
-          dbus_message_iter_next(&array_iter);
-        }
-      }
-      else
-        OFONO_WARN("Unexpected argument type in GetModems reply");
-    }
-    else
-      OFONO_WARN("GetModems returned '%s'", dbus_message_get_error_name(reply));
+  /* a reader might have loaded the old pointer and not yet taken its
+   * reference, it is released later if so */
+  if (old)
+    published_retired = g_slist_prepend(published_retired, old);
 
-    dbus_message_unref(reply);
-  }
+  ofono_manager_published_reclaim();
+}
 
-  if (user_data)
-    *(gboolean *)user_data = success;
+static gboolean
+ofono_manager_publish_idle(gpointer user_data)
+{
+  publish_id = 0;
+  ofono_manager_publish();
 
-  OFONO_EXIT
+  return G_SOURCE_REMOVE;
 }
 
-static DBusHandlerResult
-ofono_manager_modem_filter(DBusConnection *connection, DBusMessage *message,
-                           void *user_data)
+/* drops the snapshot of the modem list, it no longer matches */
+static void
+ofono_manager_modems_changed()
 {
-  OFONO_ENTER
+  modems_version++;
 
-  if (dbus_message_is_signal(message,
-                             OFONO_MANAGER_INTERFACE,
-                             "ModemAdded"))
+  if (modems_snapshot)
   {
-    DBusMessageIter iter;
-
-    if (dbus_message_iter_init(message, &iter))
-    {
-      if (!ofono_manager_add_modem(&iter))
-        OFONO_WARN("Invalid arguments for ModemAdded signal");
-    }
-    else
-      OFONO_WARN("Invalid arguments for ModemAdded signal");
+    g_hash_table_unref(modems_snapshot);
+    modems_snapshot = NULL;
   }
-  else if (dbus_message_is_signal(message,
-                                  OFONO_MANAGER_INTERFACE,
-                                  "ModemRemoved"))
+
+  if (ofono_engine_is_threaded())
   {
-    const char *path;
+    published_dirty = TRUE;
 
-    if (dbus_message_get_args(message, NULL,
-                              DBUS_TYPE_OBJECT_PATH, &path,
-                              DBUS_TYPE_INVALID))
-    {
-      modem_changed mc;
-      modem *m = modem_list_find(modems, path);
+    if (!publish_id)
+      publish_id = ofono_engine_idle_add(ofono_manager_publish_idle, NULL);
+  }
+}
 
-      mc.type = OFONO_MANAGER_MODEM_REMOVE;
+/* Modem records are never modified while somebody else holds a reference,
+ * the record is copied first if the property changes anything. */
+static guint64
+ofono_manager_modem_apply(const gchar *path, ofono_iface_type iface,
+                          const property_changed *pc)
+{
+  modem *m = modem_list_find(modems, path);
 
-      if (m)
-      {
-        mc.modem = m;
-        ofono_notifier_notify(notifiers, &mc);
-        ofono_modem_close(path, ofono_modem_property_change_cb, m);
-        ofono_sim_close(path, ofono_sim_property_change_cb, m);
-        ofono_net_close(path, ofono_net_property_change_cb, m);
-        modem_list_remove(modems, path);
-      }
-      else
-      {
-        m = modem_new(path, FALSE);
-        mc.modem = m;
-        ofono_notifier_notify(notifiers, &mc);
-        modem_free(m);
-      }
-    }
-    else
-      OFONO_WARN("Invalid arguments for ModemRemoved signal");
-  }
+  if (!m || !property_check(iface, m, pc))
+    return 0;
 
-  OFONO_EXIT
+  m = modem_list_modify(modems, path);
+  ofono_manager_modems_changed();
 
-  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  return property_update(iface, m, pc);
 }
 
-static gboolean
-ofono_manager_modems_add_dbus_filter()
+static hold_field *
+ofono_manager_hold_field(guint64 changed)
 {
-  return icd_dbus_connect_system_bcast_signal(
-        OFONO_MANAGER_INTERFACE, ofono_manager_modem_filter, NULL, NULL);
-}
+  guint i;
 
-static void
-ofono_manager_modems_remove_dbus_filter()
-{
-  icd_dbus_disconnect_system_bcast_signal(
-    OFONO_MANAGER_INTERFACE, ofono_manager_modem_filter, NULL, NULL);
+  for (i = 0; i < G_N_ELEMENTS(hold_fields); i++)
+  {
+    if (hold_fields[i].changed == changed)
+      return &hold_fields[i];
+  }
+
+  return NULL;
 }
 
-static gboolean
-ofono_manager_modems_init(DBusPendingCallNotifyFunction cb, gpointer user_data)
+static hold_pending *
+ofono_manager_hold_find(const gchar *path, const property_desc *desc)
 {
-  DBusMessage *message;
-  gboolean rv = FALSE;
-
-  OFONO_ENTER
-
-  message = dbus_message_new_method_call(OFONO_SERVICE,
-                                       OFONO_MANAGER_PATH,
-                                       OFONO_MANAGER_INTERFACE,
-                                       "GetModems");
+  GSList *l;
 
-  if (message)
+  for (l = holds; l; l = l->next)
   {
-    if (!icd_dbus_send_system_mcall(message, -1, cb, user_data))
-      OFONO_ERR("could not send 'GetModems' message");
-    else
-      rv = TRUE;
+    hold_pending *h = l->data;
 
-    dbus_message_unref(message);
+    if (h->path == path && h->desc == desc)
+      return h;
   }
-  else
-    OFONO_ERR("could not create 'GetModems' method call");
-
-  OFONO_EXIT
 
-  return rv;
-}
-
-GHashTable *
-ofono_manager_get_modems(void)
-{
-  return modems;
+  return NULL;
 }
 
 static void
-ofono_manager_get_modems_sync_cb(DBusPendingCall *pending, void *user_data)
+ofono_manager_hold_free(hold_pending *h)
 {
-  gint *finished = user_data;
-  gboolean success = FALSE;
+  holds = g_slist_remove(holds, h);
 
-  ofono_manager_get_modems_cb(pending, &success);
+  if (h->id)
+    ofono_engine_source_remove(h->id);
 
-  if (success)
-    *finished = 1;
-  else
-    *finished = -1;
+  g_free(h);
 }
 
-gboolean
-ofono_manager_get_modems_sync(void)
+/* drops the held changes of an interface of a modem, of all modems if path
+ * is NULL, of all interfaces if iface is OFONO_IFACE_LAST */
+static void
+ofono_manager_hold_drop(const gchar *path, ofono_iface_type iface)
 {
-  gint finished = 0;
-  gboolean rv = FALSE;
+  GSList *l = holds;
 
-  if (ofono_manager_modems_init(ofono_manager_get_modems_sync_cb, &finished))
+  while (l)
   {
-    do
+    hold_pending *h = l->data;
+
+    l = l->next;
+
+    if ((!path || h->path == path) &&
+        (iface == OFONO_IFACE_LAST || h->iface == iface))
+    {
+      ofono_manager_hold_free(h);
+    }
+  }
+}
+
+static void
+ofono_manager_hold_store(hold_pending *h, const property_changed *pc)
+{
+  h->type = pc->type;
+  h->val = pc->val;
+
+  if (pc->type == DBUS_TYPE_STRING)
+    h->val.str = (char *)string_pool_intern(pc->val.str);
+}
+
+static void
+ofono_manager_hold_count(guint64 changed, gsize member)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(hold_fields); i++)
+  {
+    if (changed & hold_fields[i].changed)
+      G_STRUCT_MEMBER(guint, &hold_fields[i].stats, member)++;
+  }
+}
+
+/* the loss lasted longer than the hold time */
+static gboolean
+ofono_manager_hold_timeout_cb(gpointer user_data)
+{
+  hold_pending *h = user_data;
+  ofono_iface_type iface = h->iface;
+  property_changed pc;
+
+  OFONO_ENTER
+
+  pc.path = h->path;
+  pc.property = h->desc->name;
+  pc.type = h->type;
+  pc.val = h->val;
+  ofono_manager_hold_count(h->changed, G_STRUCT_OFFSET(hold_stats, published));
+
+  h->id = 0;
+  ofono_manager_hold_free(h);
+
+  ofono_manager_modem_changed(
+        pc.path, ofono_manager_modem_apply(pc.path, iface, &pc));
+
+  OFONO_EXIT
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Holds back a change that loses a state with a hold time, until it lasts
+ * longer than that. Returns TRUE if the change is held. */
+static gboolean
+ofono_manager_hold(const modem *m, ofono_iface_type iface,
+                   const property_changed *pc, guint64 changed)
+{
+  const property_desc *desc = property_lookup(iface, pc->property);
+  hold_pending *h;
+  guint64 flaps = 0;
+  guint hold = 0;
+  guint i;
+
+  if (!desc)
+    return FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS(hold_fields); i++)
+  {
+    hold_field *f = &hold_fields[i];
+    gint value;
+
+    if (!(changed & f->changed))
+      continue;
+
+    f->stats.transitions++;
+    value = G_STRUCT_MEMBER(gint, m, f->offset);
+
+    if (f->hold && (f->any ? value != -1 : value == TRUE))
+    {
+      flaps |= f->changed;
+      hold = MAX(hold, f->hold);
+    }
+  }
+
+  h = ofono_manager_hold_find(m->path, desc);
+
+  if (h)
+  {
+    /* still lost, the latest value is published when the time is up */
+    if (flaps)
+    {
+      ofono_manager_hold_store(h, pc);
+      h->changed |= flaps;
+      return TRUE;
+    }
+
+    /* the held fields oFono reports back as they were never changed */
+    ofono_manager_hold_count(h->changed & ~changed,
+                             G_STRUCT_OFFSET(hold_stats, transitions));
+    ofono_manager_hold_count(h->changed & ~changed,
+                             G_STRUCT_OFFSET(hold_stats, absorbed));
+    ofono_manager_hold_count(h->changed & changed,
+                             G_STRUCT_OFFSET(hold_stats, published));
+    ofono_manager_hold_free(h);
+
+    return FALSE;
+  }
+
+  if (!flaps)
+    return FALSE;
+
+  OFONO_DEBUG("Holding %s of %s for %u ms", pc->property, m->path, hold);
+
+  h = g_new0(hold_pending, 1);
+  h->path = m->path;
+  h->iface = iface;
+  h->desc = desc;
+  h->changed = flaps;
+  ofono_manager_hold_store(h, pc);
+  h->id = ofono_engine_timeout_add(hold, ofono_manager_hold_timeout_cb, h);
+  holds = g_slist_prepend(holds, h);
+  ofono_manager_hold_count(flaps, G_STRUCT_OFFSET(hold_stats, held));
+
+  return TRUE;
+}
+
+/* same as ofono_manager_modem_apply(), but losses may be held back */
+static guint64
+ofono_manager_modem_update(const gchar *path, ofono_iface_type iface,
+                           const property_changed *pc)
+{
+  const modem *m = modem_list_find(modems, path);
+
+  if (!m || ofono_manager_hold(m, iface, pc, property_check(iface, m, pc)))
+    return 0;
+
+  return ofono_manager_modem_apply(path, iface, pc);
+}
+
+/* Keys of the modem list change when a record is copied on write, so the
+ * watches of a modem take the path from the changed property instead. */
+static void
+ofono_sim_property_change_cb(gpointer data, gpointer user_data)
+{
+  property_changed *pc = data;
+  const gchar *path = pc->path;
+
+  OFONO_ENTER
+
+  OFONO_DEBUG("SIM property changed %s", pc->property);
+
+  ofono_manager_modem_changed(
+        path, ofono_manager_modem_update(path, OFONO_IFACE_SIM, pc));
+
+  OFONO_EXIT
+}
+
+static void
+ofono_net_property_change_cb(gpointer data, gpointer user_data)
+{
+  property_changed *pc = data;
+  const gchar *path = pc->path;
+
+  OFONO_ENTER
+
+  OFONO_DEBUG("NET property changed %s", pc->property);
+
+  ofono_manager_modem_changed(
+        path, ofono_manager_modem_update(path, OFONO_IFACE_NET, pc));
+
+  OFONO_EXIT
+}
+
+static void
+ofono_conn_property_change_cb(gpointer data, gpointer user_data)
+{
+  property_changed *pc = data;
+  const gchar *path = pc->path;
+
+  OFONO_ENTER
+
+  OFONO_DEBUG("CONN property changed %s", pc->property);
+
+  ofono_manager_modem_changed(
+        path, ofono_manager_modem_update(path, OFONO_IFACE_CONN, pc));
+
+  OFONO_EXIT
+}
+
+static void
+ofono_lte_property_change_cb(gpointer data, gpointer user_data)
+{
+  property_changed *pc = data;
+  const gchar *path = pc->path;
+
+  OFONO_ENTER
+
+  OFONO_DEBUG("LTE property changed %s", pc->property);
+
+  ofono_manager_modem_changed(
+        path, ofono_manager_modem_update(path, OFONO_IFACE_LTE, pc));
+
+  OFONO_EXIT
+}
+
+/* the modem record owns a reference of the context, changed holds the
+ * OFONO_MODEM_CHANGED_CONTEXT_* bits of the properties that changed */
+static void
+ofono_manager_context_set(const gchar *path, modem_context *c,
+                          guint64 changed)
+{
+  modem *m = modem_list_modify(modems, path);
+
+  modem_set_context(m, c);
+  ofono_manager_modems_changed();
+  ofono_manager_modem_changed(path, OFONO_MODEM_CHANGED_CONTEXTS | changed);
+}
+
+/* Context watches get the pooled modem path as user data, the contexts
+ * themselves are copied on write like the modem records. */
+static void
+ofono_manager_context_property_cb(gpointer data, gpointer user_data)
+{
+  DBusMessage *message = data;
+  const gchar *path = user_data;
+  const modem *m = modem_list_find(modems, path);
+  const modem_context *old = NULL;
+  DBusMessageIter iter;
+  modem_context *c;
+  guint64 changed;
+
+  if (m)
+    old = modem_find_context(m, dbus_message_get_path(message));
+
+  if (!old || !dbus_message_iter_init(message, &iter))
+    return;
+
+  OFONO_ENTER
+
+  c = modem_context_dup(old);
+
+  if ((changed = ofono_context_read_property(&iter, c)))
+    ofono_manager_context_set(path, c, changed);
+  else
+    modem_context_unref(c);
+
+  OFONO_EXIT
+}
+
+/* iter points to the properties of a new or already known context */
+static void
+ofono_manager_context_add(const modem *m, const char *context_path,
+                          DBusMessageIter *iter)
+{
+  const gchar *path = m->path;
+  const modem_context *old = modem_find_context(m, context_path);
+  modem_context *c;
+  guint64 changed;
+
+  if (old)
+    c = modem_context_dup(old);
+  else
+  {
+    c = modem_context_new(context_path);
+
+    if (!ofono_context_watch(c->path, ofono_manager_context_property_cb,
+                             (gpointer)path))
+    {
+      OFONO_WARN("Cannot watch context %s", c->path);
+    }
+  }
+
+  changed = ofono_context_read_properties(iter, c);
+
+  if (changed || !old)
+    ofono_manager_context_set(path, c, changed);
+  else
+    modem_context_unref(c);
+}
+
+static void
+ofono_manager_context_remove(const modem *m, const char *context_path)
+{
+  const gchar *path = m->path;
+  const modem_context *c = modem_find_context(m, context_path);
+
+  if (!c)
+    return;
+
+  ofono_context_close(c->path, ofono_manager_context_property_cb,
+                      (gpointer)path);
+  modem_remove_context(modem_list_modify(modems, path), context_path);
+  ofono_manager_modems_changed();
+  ofono_manager_modem_changed(path, OFONO_MODEM_CHANGED_CONTEXTS);
+}
+
+static void
+ofono_manager_contexts_signal_cb(gpointer data, gpointer user_data)
+{
+  DBusMessage *message = data;
+  const modem *m = modem_list_find(modems, dbus_message_get_path(message));
+  DBusMessageIter iter;
+  const char *context_path;
+
+  if (!m || !dbus_message_iter_init(message, &iter) ||
+      dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_OBJECT_PATH)
+  {
+    return;
+  }
+
+  OFONO_ENTER
+
+  dbus_message_iter_get_basic(&iter, &context_path);
+
+  if (dbus_message_has_member(message, "ContextAdded"))
+  {
+    dbus_message_iter_next(&iter);
+    ofono_manager_context_add(m, context_path, &iter);
+  }
+  else if (dbus_message_has_member(message, "ContextRemoved"))
+    ofono_manager_context_remove(m, context_path);
+
+  OFONO_EXIT
+}
+
+static void
+ofono_manager_get_contexts_cb(DBusMessage *reply, gpointer user_data)
+{
+  const gchar *path = user_data;
+  DBusMessageIter iter;
+  DBusMessageIter array_iter;
+
+  /* cancelled when the contexts are no longer watched */
+  if (!reply)
+    return;
+
+  OFONO_ENTER
+
+  if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+  {
+    OFONO_WARN("GetContexts of %s returned '%s'", path,
+               dbus_message_get_error_name(reply));
+  }
+  else if (dbus_message_iter_init(reply, &iter) &&
+           dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+  {
+    dbus_message_iter_recurse(&iter, &array_iter);
+
+    while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRUCT)
+    {
+      DBusMessageIter struct_iter;
+      const modem *m = modem_list_find(modems, path);
+      const char *context_path;
+
+      if (!m)
+        break;
+
+      dbus_message_iter_recurse(&array_iter, &struct_iter);
+
+      if (dbus_message_iter_get_arg_type(&struct_iter) ==
+          DBUS_TYPE_OBJECT_PATH)
+      {
+        dbus_message_iter_get_basic(&struct_iter, &context_path);
+        dbus_message_iter_next(&struct_iter);
+        ofono_manager_context_add(m, context_path, &struct_iter);
+      }
+
+      dbus_message_iter_next(&array_iter);
+    }
+  }
+  else
+    OFONO_WARN("Unexpected argument type in GetContexts reply");
+
+  OFONO_EXIT
+}
+
+/* path must be pooled */
+static void
+ofono_manager_contexts_open(const gchar *path)
+{
+  if (ofono_conn_contexts_register(path, ofono_manager_contexts_signal_cb,
+                                   NULL))
+  {
+    ofono_conn_get_contexts(path, ofono_manager_get_contexts_cb,
+                            (gpointer)path);
+  }
+}
+
+/* closes the watches of the contexts, the record is left as it is */
+static void
+ofono_manager_contexts_close(const modem *m)
+{
+  guint i;
+
+  ofono_conn_contexts_close(m->path, ofono_manager_contexts_signal_cb, NULL);
+
+  for (i = 0; m->contexts && i < m->contexts->len; i++)
+  {
+    const modem_context *c = g_ptr_array_index(m->contexts, i);
+
+    ofono_context_close(c->path, ofono_manager_context_property_cb,
+                        (gpointer)m->path);
+  }
+}
+
+/* Path must be pooled. Drops what is held back for a closed interface and
+ * resets its fields, returns the fields that had a value. */
+static guint64
+ofono_manager_interface_detach(const gchar *path, ofono_iface_type iface)
+{
+  guint64 changed;
+
+  ofono_manager_hold_drop(path, iface);
+
+  if (policy_filter)
+  {
+    change_filter_forget_fields(policy_filter, path,
+                                property_changed_mask(iface));
+  }
+
+  changed = property_reset(iface, modem_list_modify(modems, path));
+  ofono_manager_modems_changed();
+
+  return changed;
+}
+
+/* Path must be pooled, returns the fields that changed on the way. Closed
+ * interfaces get their fields reset, whether the modem lost them or they are
+ * no longer watched. */
+static guint64
+ofono_manager_modem_interfaces_changed(const gchar *path, guint64 interfaces,
+                                       guint64 old)
+{
+  guint64 diff = interfaces ^ old;
+  guint64 changed = 0;
+
+  if (diff & OFONO_MODEM_INTERFACE_SIM_MANAGER)
+  {
+    if (old & OFONO_MODEM_INTERFACE_SIM_MANAGER)
+    {
+      ofono_sim_close(path, ofono_sim_property_change_cb, NULL);
+      changed |= ofono_manager_interface_detach(path, OFONO_IFACE_SIM);
+    }
+    else
+      ofono_sim_register(path, ofono_sim_property_change_cb, NULL);
+  }
+
+  if (diff & OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION)
+  {
+    if (old & OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION)
+    {
+      ofono_net_close(path, ofono_net_property_change_cb, NULL);
+      changed |= ofono_manager_interface_detach(path, OFONO_IFACE_NET);
+    }
+    else
+      ofono_net_register(path, ofono_net_property_change_cb, NULL);
+  }
+
+  if (diff & OFONO_MODEM_INTERFACE_LTE)
+  {
+    if (old & OFONO_MODEM_INTERFACE_LTE)
+    {
+      ofono_lte_close(path, ofono_lte_property_change_cb, NULL);
+      changed |= ofono_manager_interface_detach(path, OFONO_IFACE_LTE);
+    }
+    else
+      ofono_lte_register(path, ofono_lte_property_change_cb, NULL);
+  }
+
+  if (diff & OFONO_MODEM_INTERFACE_CONNECTION_MANAGER)
+  {
+    if (old & OFONO_MODEM_INTERFACE_CONNECTION_MANAGER)
+    {
+      const modem *m = modem_list_find(modems, path);
+
+      ofono_conn_close(path, ofono_conn_property_change_cb, NULL);
+      ofono_manager_contexts_close(m);
+
+      /* the context objects are gone with the interface */
+      if (m->contexts)
+      {
+        modem_clear_contexts(modem_list_modify(modems, path));
+        ofono_manager_modems_changed();
+        changed |= OFONO_MODEM_CHANGED_CONTEXTS;
+      }
+
+      changed |= ofono_manager_interface_detach(path, OFONO_IFACE_CONN);
+    }
+    else
+    {
+      ofono_conn_register(path, ofono_conn_property_change_cb, NULL);
+      ofono_manager_contexts_open(path);
+    }
+  }
+
+  return changed;
+}
+
+static void
+ofono_modem_property_change_cb(gpointer data, gpointer user_data)
+{
+  property_changed *pc = data;
+  const gchar *path = pc->path;
+  modem *m = modem_list_find(modems, path);
+  guint64 old;
+  guint64 changed;
+
+  if (!m)
+    return;
+
+  OFONO_ENTER
+
+  OFONO_DEBUG("Modem %s property changed %s", path, pc->property);
+
+  old = m->interfaces;
+  changed = ofono_manager_modem_update(path, OFONO_IFACE_MODEM, pc);
+
+  if (changed & OFONO_MODEM_CHANGED_INTERFACES)
+  {
+    m = modem_list_find(modems, path);
+    changed |= ofono_manager_modem_interfaces_changed(
+          path, m->interfaces & watched_interfaces, old & watched_interfaces);
+  }
+
+  ofono_manager_modem_changed(path, changed);
+
+  OFONO_EXIT
+}
+
+static void
+ofono_manager_modem_read_properties(DBusMessageIter *iter, const gchar *path,
+                                    gboolean notify)
+{
+  DBusMessageIter sub;
+
+  dbus_message_iter_recurse(iter, &sub);
+
+  while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_DICT_ENTRY)
+  {
+    DBusMessageIter dict;
+    property_changed pc;
+
+    dbus_message_iter_recurse(&sub, &dict);
+    pc.path = path;
+    pc.type = ofono_modem_read_property(&dict, &pc);
+
+    if (pc.type != DBUS_TYPE_INVALID)
+    {
+      if (notify)
+        ofono_modem_property_change_cb(&pc, NULL);
+      else
+        property_update(OFONO_IFACE_MODEM, modem_list_find(modems, path), &pc);
+    }
+
+    dbus_message_iter_next(&sub);
+  }
+}
+
+static void
+_ofono_manager_add_modem(const gchar *path, DBusMessageIter *properties)
+{
+  modem *m;
+
+  /* everything below keys on the pooled path */
+  path = string_pool_intern(path);
+
+  if (!modem_list_find(modems, path))
+  {
+    modem_list_insert(modems, modem_new(path, FALSE));
+    ofono_manager_modems_changed();
+
+    /* the properties come with the modem, no need to ask for them again.
+     * Nobody has seen the record yet, so it is filled in place. */
+    ofono_manager_modem_read_properties(properties, path, FALSE);
+    m = modem_list_find(modems, path);
+
+    /* the initial values are the reference of the deadbands */
+    if (policy_filter)
+      change_filter_apply(policy_filter, m, OFONO_MODEM_CHANGED_ALL);
+
+    ofono_manager_notify(OFONO_MANAGER_MODEM_ADD, m, OFONO_MODEM_CHANGED_ALL);
+
+    /* a notifier might have stopped the tracking */
+    if (!(m = modem_list_find(modems, path)))
+      return;
+
+    ofono_modem_watch(path, ofono_modem_property_change_cb, NULL);
+    ofono_manager_modem_interfaces_changed(
+          path, m->interfaces & watched_interfaces, 0);
+  }
+  else
+    ofono_manager_modem_read_properties(properties, path, TRUE);
+
+  m = modem_list_find(modems, path);
+
+  if (m && !m->powered)
+  {
+    OFONO_INFO("Powering on %s", path);
+    ofono_manager_modem_set_power(path, TRUE, NULL, NULL);
+  }
+}
+
+static gboolean
+ofono_manager_add_modem(DBusMessageIter *iter)
+{
+  gchar *path;
+  gboolean rv = FALSE;
+
+  OFONO_ENTER
+
+  if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_OBJECT_PATH)
+  {
+    dbus_message_iter_get_basic(iter, &path);
+
+    dbus_message_iter_next(iter);
+
+    if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_ARRAY)
+    {
+      _ofono_manager_add_modem(path, iter);
+      rv = TRUE;
+    }
+  }
+  else
+    OFONO_WARN("Unknown dbus iterator arg type when adding modem");
+
+  OFONO_EXIT
+
+  return rv;
+}
+
+static gboolean
+ofono_manager_get_modems_reply(DBusMessage *reply, GError **error)
+{
+  DBusMessageIter iter;
+  gboolean rv = TRUE;
+
+  OFONO_ENTER
+
+  if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+  {
+    OFONO_WARN("GetModems returned '%s'", dbus_message_get_error_name(reply));
+    dbus_helper_set_error(error, reply);
+    rv = FALSE;
+  }
+  else
+  {
+    dbus_message_iter_init(reply, &iter);
+
+    if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+    {
+      DBusMessageIter array_iter;
+
+      dbus_message_iter_recurse(&iter, &array_iter);
+
+      while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRUCT)
+      {
+        DBusMessageIter struct_iter;
+
+        dbus_message_iter_recurse(&array_iter, &struct_iter);
+
+        if (!ofono_manager_add_modem(&struct_iter))
+        {
+          OFONO_WARN("Cannot add modem while processing GetModems reply");
+          g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                              "Invalid modem in GetModems reply");
+          rv = FALSE;
+          break;
+        }
+
+        dbus_message_iter_next(&array_iter);
+      }
+    }
+    else
+    {
+      OFONO_WARN("Unexpected argument type in GetModems reply");
+      g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                          "Unexpected argument type in GetModems reply");
+      rv = FALSE;
+    }
+  }
+
+  OFONO_EXIT
+
+  return rv;
+}
+
+static void
+ofono_manager_signal_cb(gpointer data, gpointer user_data)
+{
+  DBusMessage *message = data;
+
+  OFONO_ENTER
+
+  if (dbus_message_has_member(message, "ModemAdded"))
+  {
+    DBusMessageIter iter;
+
+    if (dbus_message_iter_init(message, &iter))
+    {
+      if (!ofono_manager_add_modem(&iter))
+        OFONO_WARN("Invalid arguments for ModemAdded signal");
+    }
+    else
+      OFONO_WARN("Invalid arguments for ModemAdded signal");
+  }
+  else if (dbus_message_has_member(message, "ModemRemoved"))
+  {
+    const char *path;
+
+    if (dbus_message_get_args(message, NULL,
+                              DBUS_TYPE_OBJECT_PATH, &path,
+                              DBUS_TYPE_INVALID))
     {
-      g_main_context_iteration(NULL, TRUE);
+      const modem *m = modem_list_find(modems, path);
+
+      if (m)
+      {
+        /* keep it for the notifiers, consumers must no longer find it in
+         * the list or the snapshot when they are told it is gone */
+        modem_ref(m);
+
+        ofono_manager_drop_changes(m->path);
+        ofono_modem_close(path, ofono_modem_property_change_cb, NULL);
+        ofono_sim_close(path, ofono_sim_property_change_cb, NULL);
+        ofono_net_close(path, ofono_net_property_change_cb, NULL);
+        ofono_conn_close(path, ofono_conn_property_change_cb, NULL);
+        ofono_lte_close(path, ofono_lte_property_change_cb, NULL);
+        ofono_manager_contexts_close(m);
+        modem_list_remove(modems, m->path);
+        ofono_manager_modems_changed();
+        ofono_manager_notify(OFONO_MANAGER_MODEM_REMOVE, m,
+                             OFONO_MODEM_CHANGED_ALL);
+        modem_unref(m);
+      }
+      else
+      {
+        modem *unknown = modem_new(path, FALSE);
+
+        ofono_manager_notify(OFONO_MANAGER_MODEM_REMOVE, unknown,
+                             OFONO_MODEM_CHANGED_ALL);
+        modem_free(unknown);
+      }
     }
-    while (!finished);
+    else
+      OFONO_WARN("Invalid arguments for ModemRemoved signal");
+  }
+
+  OFONO_EXIT
+}
+
+/* Context properties are taken from GetContexts and ContextAdded, the same
+ * way as the modem ones, so context signals are received for all contexts
+ * while connection managers are watched. */
+static gboolean
+ofono_manager_contexts_watch_all()
+{
+  if (!contexts_watched)
+    contexts_watched = ofono_iface_watch_all(OFONO_IFACE_CONTEXT);
+
+  return contexts_watched;
+}
+
+static void
+ofono_manager_contexts_unwatch_all()
+{
+  if (contexts_watched)
+  {
+    ofono_iface_unwatch_all(OFONO_IFACE_CONTEXT);
+    contexts_watched = FALSE;
+  }
+}
+
+/* Modem properties are taken from GetModems and ModemAdded, so Modem signals
+ * must be received for all modems before those arrive, otherwise changes
+ * between the reply and the per-modem match rule would be lost. */
+static gboolean
+ofono_manager_modems_add_dbus_filter()
+{
+  if (!ofono_iface_register(OFONO_MANAGER_PATH, OFONO_IFACE_MANAGER,
+                            ofono_manager_signal_cb, NULL))
+  {
+    return FALSE;
+  }
+
+  if (!ofono_iface_watch_all(OFONO_IFACE_MODEM) ||
+      ((watched_interfaces & OFONO_MODEM_INTERFACE_CONNECTION_MANAGER) &&
+       !ofono_manager_contexts_watch_all()))
+  {
+    ofono_iface_unwatch_all(OFONO_IFACE_MODEM);
+    ofono_iface_close(OFONO_MANAGER_PATH, OFONO_IFACE_MANAGER,
+                      ofono_manager_signal_cb, NULL);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+ofono_manager_modems_remove_dbus_filter()
+{
+  ofono_manager_contexts_unwatch_all();
+  ofono_iface_unwatch_all(OFONO_IFACE_MODEM);
+  ofono_iface_close(OFONO_MANAGER_PATH, OFONO_IFACE_MANAGER,
+                    ofono_manager_signal_cb, NULL);
+}
+
+static void
+ofono_manager_deliver_ready(gpointer data)
+{
+  manager_ready *r = data;
+
+  if (r->generation == generation && !ready)
+  {
+    ofono_notifier_list *l = ready_notifiers;
+
+    ready = TRUE;
+    ready_result = r->result;
+
+    /* ready notifiers are called only once */
+    ready_notifiers = NULL;
+    ofono_notifier_notify(l, &ready_result);
+    ofono_notifier_close(&l, NULL, NULL);
+  }
+
+  g_free(r);
+}
+
+static void
+ofono_manager_check_ready()
+{
+  manager_ready *r;
+
+  if (startup_done || !startup_listed || ofono_iface_fetch_pending())
+    return;
+
+  startup_done = TRUE;
+  startup_result.elapsed = g_get_monotonic_time() - startup_time;
+
+  OFONO_INFO("Initial modem state %s in %" G_GINT64_FORMAT " us",
+             startup_result.success ? "complete" : "incomplete",
+             startup_result.elapsed);
+
+  if (ofono_engine_is_threaded())
+    ofono_manager_publish();
+
+  r = g_new(manager_ready, 1);
+  r->generation = engine_generation;
+  r->result = startup_result;
+  ofono_engine_post(ofono_manager_deliver_ready, r);
+}
+
+static void
+ofono_manager_fetch_done_cb(gpointer data, gpointer user_data)
+{
+  ofono_manager_check_ready();
+}
+
+static void
+ofono_manager_startup_cb(DBusMessage *reply, gpointer user_data)
+{
+  /* cancelled by ofono_manager_modems_close() */
+  if (!reply)
+    return;
+
+  OFONO_ENTER
+
+  /* interface properties are requested while the reply is processed, so by
+   * the time it returns every startup call is already in flight */
+  startup_result.success = ofono_manager_get_modems_reply(reply, NULL);
+  startup_listed = TRUE;
+  ofono_manager_check_ready();
+
+  OFONO_EXIT
+}
+
+static void
+ofono_manager_startup_reset()
+{
+  ofono_iface_fetch_done_close(ofono_manager_fetch_done_cb, NULL);
+  startup_listed = FALSE;
+  startup_done = FALSE;
+}
+
+static gboolean
+ofono_manager_modems_init(ofono_iface_reply_fn cb, gpointer user_data)
+{
+  DBusMessage *message;
+  gboolean rv = FALSE;
+
+  OFONO_ENTER
+
+  message = dbus_message_new_method_call(OFONO_SERVICE,
+                                       OFONO_MANAGER_PATH,
+                                       OFONO_MANAGER_INTERFACE,
+                                       "GetModems");
+
+  if (message)
+  {
+    if (!ofono_iface_call(OFONO_IFACE_MANAGER, message, cb, user_data))
+      OFONO_ERR("could not send 'GetModems' message");
+    else
+      rv = TRUE;
+
+    dbus_message_unref(message);
+  }
+  else
+    OFONO_ERR("could not create 'GetModems' method call");
+
+  OFONO_EXIT
+
+  return rv;
+}
+
+/**
+ * @brief Gets the table of tracked modems, path -> #modem. The table and its
+ * records are owned by the library and change as modems come and go, take a
+ * reference with #modem_ref or use #ofono_manager_get_modems_snapshot to keep
+ * them. With an engine thread the table may only be used from its context,
+ * use #ofono_manager_get_modems_snapshot anywhere else.
+ *
+ * @return The table or NULL if modems are not tracked
+ */
+GHashTable *
+ofono_manager_get_modems(void)
+{
+  return modems;
+}
+
+/**
+ * @brief Gets an immutable snapshot of all tracked modems, path -> #modem.
+ * The snapshot is built once and shared until the list or any of its modems
+ * changes, so getting it again meanwhile only takes a reference. Records in
+ * it are never modified, the library copies them on the next change instead.
+ * With an engine thread it can be called from any thread without locking, the
+ * snapshot already contains every change delivered to the notifiers.
+ *
+ * @param version Return location for the version of the list or NULL. It
+ * changes every time the list or any of its modems does.
+ *
+ * @return The snapshot, must not be modified and must be released with
+ * g_hash_table_unref(). NULL if modems are not tracked
+ */
+GHashTable *
+ofono_manager_get_modems_snapshot(guint64 *version)
+{
+  modems_published *p;
+  GHashTable *rv = NULL;
+
+  if (!ofono_engine_is_threaded())
+  {
+    if (!modems)
+      return NULL;
+
+    if (version)
+      *version = modems_version;
+
+    return g_hash_table_ref(ofono_manager_snapshot());
+  }
+
+  g_atomic_int_inc(&published_readers);
+  p = g_atomic_pointer_get(&published);
+
+  if (p)
+  {
+    rv = g_hash_table_ref(p->modems);
+
+    if (version)
+      *version = p->version;
+  }
+
+  g_atomic_int_add(&published_readers, -1);
+
+  return rv;
+}
+
+static void
+ofono_manager_get_modems_async_cb(DBusMessage *reply, gpointer user_data)
+{
+  GTask *task = user_data;
+  GError *error = NULL;
+
+  OFONO_ENTER
+
+  if (g_cancellable_set_error_if_cancelled(g_task_get_cancellable(task),
+                                           &error))
+  {
+    g_task_return_error(task, error);
+  }
+  else if (!reply || !modems)
+  {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                            "Modems are no longer tracked");
+  }
+  else if (ofono_manager_get_modems_reply(reply, &error))
+    g_task_return_boolean(task, TRUE);
+  else
+    g_task_return_error(task, error);
+
+  g_object_unref(task);
+
+  OFONO_EXIT
+}
+
+static void
+ofono_manager_get_modems_async_start(gpointer data)
+{
+  manager_call *call = data;
+
+  if (!modems)
+  {
+    g_task_return_new_error(call->task, G_IO_ERROR,
+                            G_IO_ERROR_NOT_INITIALIZED,
+                            "Modems are not tracked");
+    g_object_unref(call->task);
+  }
+  else if (!ofono_manager_modems_init(ofono_manager_get_modems_async_cb,
+                                      call->task))
+  {
+    g_task_return_new_error(call->task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                            "Could not send GetModems");
+    g_object_unref(call->task);
+  }
+}
+
+/**
+ * @brief Asynchronously refreshes the list of modems from GetModems. Modems
+ * must be tracked with #ofono_manager_modems_register. Changes are delivered
+ * to the registered notifiers before @a callback is called.
+ *
+ * @param cancellable A #GCancellable or NULL
+ * @param callback Called when the modem list is up to date or on error, call
+ * #ofono_manager_get_modems_finish from it to get the result
+ * @param user_data User data passed to @a callback
+ */
+void
+ofono_manager_get_modems_async(GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+  manager_call call = {0};
+
+  /* created here so that it completes on the context of the caller */
+  call.task = g_task_new(NULL, cancellable, callback, user_data);
+  g_task_set_source_tag(call.task, ofono_manager_get_modems_async);
+  ofono_engine_call(ofono_manager_get_modems_async_start, &call);
+}
+
+gboolean
+ofono_manager_get_modems_finish(GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+  return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+static gboolean
+_ofono_manager_get_modems_sync(gint timeout, GError **error)
+{
+  DBusConnection *connection = ofono_engine_get_connection();
+  DBusMessage *message;
+  DBusMessage *reply;
+  DBusError dbus_error;
+  gboolean rv = FALSE;
+
+  OFONO_ENTER
+
+  if (!modems)
+  {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED,
+                        "Modems are not tracked");
+    return FALSE;
+  }
+
+  if (!connection)
+  {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                        "No system bus connection");
+    return FALSE;
+  }
+
+  message = dbus_message_new_method_call(OFONO_SERVICE,
+                                         OFONO_MANAGER_PATH,
+                                         OFONO_MANAGER_INTERFACE,
+                                         "GetModems");
+
+  if (!message)
+  {
+    OFONO_ERR("could not create 'GetModems' method call");
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                        "Could not create GetModems");
+    return FALSE;
+  }
+
+  dbus_error_init(&dbus_error);
+  reply = dbus_connection_send_with_reply_and_block(connection, message,
+                                                    timeout, &dbus_error);
+  dbus_message_unref(message);
+
+  if (reply)
+  {
+    rv = ofono_manager_get_modems_reply(reply, error);
+    dbus_message_unref(reply);
+  }
+  else
+  {
+    OFONO_WARN("GetModems failed with '%s'", dbus_error.name);
+    g_dbus_error_set_dbus_error(error, dbus_error.name, dbus_error.message,
+                                NULL);
+    dbus_error_free(&dbus_error);
+  }
+
+  OFONO_EXIT
+
+  return rv;
+}
+
+static void
+ofono_manager_get_modems_sync_cb(gpointer data)
+{
+  manager_call *call = data;
+
+  call->rv = _ofono_manager_get_modems_sync(call->timeout, call->error);
+}
+
+/**
+ * @brief Synchronously refreshes the list of modems from GetModems. The call
+ * blocks on the D-Bus connection only, no main context is iterated, so no
+ * other event sources run while waiting. With an engine thread the engine
+ * waits as well.
+ *
+ * @param timeout Maximum time to wait for the reply in milliseconds, -1 for
+ * the D-Bus default
+ * @param error Return location for the error or NULL
+ *
+ * @return TRUE on success
+ */
+gboolean
+ofono_manager_get_modems_sync_timeout(gint timeout, GError **error)
+{
+  manager_call call = {0};
 
-    if (finished == 1)
-      rv = TRUE;
+  call.timeout = timeout;
+  call.error = error;
+  ofono_engine_call(ofono_manager_get_modems_sync_cb, &call);
+
+  return call.rv;
+}
+
+/**
+ * @brief Deprecated, use #ofono_manager_get_modems_async or
+ * #ofono_manager_get_modems_sync_timeout instead.
+ */
+gboolean
+ofono_manager_get_modems_sync(void)
+{
+  return ofono_manager_get_modems_sync_timeout(-1, NULL);
+}
+
+/* OFONO_MODEM_INTERFACE_* bit or 0 for the modem itself -> interface */
+static ofono_iface_type
+ofono_manager_interface_type(guint64 interface)
+{
+  if (interface == 0)
+    return OFONO_IFACE_MODEM;
+  else if (interface == OFONO_MODEM_INTERFACE_SIM_MANAGER)
+    return OFONO_IFACE_SIM;
+  else if (interface == OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION)
+    return OFONO_IFACE_NET;
+  else if (interface == OFONO_MODEM_INTERFACE_CONNECTION_MANAGER)
+    return OFONO_IFACE_CONN;
+  else if (interface == OFONO_MODEM_INTERFACE_LTE)
+    return OFONO_IFACE_LTE;
+
+  return OFONO_IFACE_LAST;
+}
+
+static void
+ofono_manager_modem_fetch_start(gpointer data)
+{
+  manager_call *call = data;
+  modem *m = modem_list_find(modems, call->path);
+  ofono_iface_type type = ofono_manager_interface_type(call->interface);
+
+  if (!m)
+  {
+    g_task_return_new_error(call->task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                            "Unknown modem %s", call->path);
+    g_object_unref(call->task);
+  }
+  else if (type == OFONO_IFACE_LAST ||
+           (call->interface && !modem_interface_supported(m, call->interface)))
+  {
+    g_task_return_new_error(call->task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                            "Interface is not available on %s", call->path);
+    g_object_unref(call->task);
   }
+  else
+    ofono_iface_fetch_task(call->path, type, call->task);
+}
 
-  return rv;
+/**
+ * @brief Asynchronously refreshes the properties of a modem interface. The
+ * changes are delivered to the registered notifiers before @a callback is
+ * called.
+ *
+ * @param path Modem object path
+ * @param interface One of OFONO_MODEM_INTERFACE_* or 0 for the modem itself
+ * @param cancellable A #GCancellable or NULL
+ * @param callback Called when the properties are up to date or on error,
+ * call #ofono_manager_modem_fetch_finish from it to get the result
+ * @param user_data User data passed to @a callback
+ */
+void
+ofono_manager_modem_fetch_async(const char *path, guint64 interface,
+                                GCancellable *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data)
+{
+  manager_call call = {0};
+
+  call.path = path;
+  call.interface = interface;
+  call.task = g_task_new(NULL, cancellable, callback, user_data);
+  g_task_set_source_tag(call.task, ofono_manager_modem_fetch_async);
+  ofono_engine_call(ofono_manager_modem_fetch_start, &call);
 }
 
 gboolean
-ofono_manager_modems_register(ofono_notify_fn cb, gpointer user_data)
+ofono_manager_modem_fetch_finish(GAsyncResult *result, GError **error)
 {
-  gboolean rv = TRUE;
+  return ofono_iface_fetch_finish(result, error);
+}
+
+static void
+ofono_manager_start_tracking(gpointer data)
+{
+  manager_call *call = data;
+  gboolean rv;
+
+  engine_generation = call->generation;
+  modems = modem_list_create();
+
+  startup_time = g_get_monotonic_time();
+  ofono_iface_fetch_done_register(ofono_manager_fetch_done_cb, NULL);
+
+  if ((rv = ofono_manager_modems_add_dbus_filter()))
+  {
+    if (!(rv = ofono_manager_modems_init(ofono_manager_startup_cb, NULL)))
+      ofono_manager_modems_remove_dbus_filter();
+  }
+
+  if (!rv)
+  {
+    ofono_manager_startup_reset();
+    modem_list_free(modems);
+    modems = NULL;
+  }
+  else
+    ofono_manager_modems_changed();
+
+  call->rv = rv;
+}
+
+static void
+ofono_manager_stop_tracking(gpointer data)
+{
+  GHashTableIter iter;
+  gpointer p;
+  gpointer m;
+
+  /* closing the watches cancels the calls in flight, ready notifiers must
+   * not see that */
+  ofono_manager_startup_reset();
+  ofono_manager_modems_remove_dbus_filter();
+  ofono_manager_cancel_changes();
+
+  g_hash_table_iter_init (&iter, modems);
+
+  while (g_hash_table_iter_next (&iter, &p, &m))
+  {
+    const gchar *path = p;
+
+    ofono_manager_contexts_close(m);
+    ofono_modem_close(path, ofono_modem_property_change_cb, NULL);
+    ofono_sim_close(path, ofono_sim_property_change_cb, NULL);
+    ofono_net_close(path, ofono_net_property_change_cb, NULL);
+    ofono_conn_close(path, ofono_conn_property_change_cb, NULL);
+    ofono_lte_close(path, ofono_lte_property_change_cb, NULL);
+  }
+
+  /* snapshots taken by consumers stay valid */
+  modem_list_free(modems);
+  modems = NULL;
+  ofono_manager_modems_changed();
+
+  if (ofono_engine_is_threaded())
+    ofono_manager_publish();
+}
+
+/* Interfaces no longer watched are closed and their fields reset, the ones
+ * watched now are registered, which fetches their properties. */
+static void
+ofono_manager_set_interests_cb(gpointer data)
+{
+  manager_call *call = data;
+  guint64 old = watched_interfaces;
+  GList *paths;
+  GList *l;
+
+  watched_interfaces = call->interface;
 
   if (!modems)
+    return;
+
+  /* ContextAdded and GetContexts must not race the context signals */
+  if ((watched_interfaces & OFONO_MODEM_INTERFACE_CONNECTION_MANAGER) &&
+      !ofono_manager_contexts_watch_all())
+  {
+    OFONO_WARN("Cannot watch contexts");
+  }
+
+  /* the table is modified on the way */
+  paths = g_hash_table_get_keys(modems);
+
+  for (l = paths; l; l = l->next)
   {
-    modems = modem_list_create();
+    const gchar *path = l->data;
+    const modem *m = modem_list_find(modems, path);
 
-    if ((rv = ofono_manager_modems_init(ofono_manager_get_modems_cb, NULL)))
-        rv = ofono_manager_modems_add_dbus_filter();
+    ofono_manager_modem_changed(
+          path, ofono_manager_modem_interfaces_changed(
+            path, m->interfaces & watched_interfaces, m->interfaces & old));
   }
 
-  if (rv)
-    ofono_notifier_register(&notifiers, cb, user_data);
+  g_list_free(paths);
 
-  return rv;
+  if (!(watched_interfaces & OFONO_MODEM_INTERFACE_CONNECTION_MANAGER))
+    ofono_manager_contexts_unwatch_all();
 }
 
-void
-ofono_manager_modems_close(ofono_notify_fn cb, gpointer user_data)
+static void
+ofono_manager_update_interests()
 {
-  ofono_notifier_close(&notifiers, cb, user_data);
+  guint64 rv = 0;
+  GSList *l;
 
-  if (!notifiers)
+  for (l = subscriptions; l; l = l->next)
+    rv |= ((manager_subscription *)l->data)->interests;
+
+  if (rv != interests)
   {
-    GHashTableIter iter;
-    gpointer p, q;
+    manager_call call = {0};
+
+    interests = rv;
+    call.interface = rv;
+    ofono_engine_call(ofono_manager_set_interests_cb, &call);
+  }
+}
+
+static void
+ofono_manager_unsubscribe(ofono_notify_fn cb, gpointer user_data)
+{
+  gboolean all = !cb && !user_data;
+  GSList *l = subscriptions;
 
-    ofono_manager_modems_remove_dbus_filter();
+  while (l)
+  {
+    manager_subscription *s = l->data;
 
-    g_hash_table_iter_init (&iter, modems);
+    l = l->next;
 
-    while (g_hash_table_iter_next (&iter, &p, &q))
+    if (all || (s->cb == cb && s->user_data == user_data))
     {
-      const gchar *path = p;
-      modem *m = q;
+      subscriptions = g_slist_remove(subscriptions, s);
+      g_free(s);
+    }
+  }
+}
+
+static manager_subscription *
+ofono_manager_subscription_find(ofono_notify_fn cb, gpointer user_data)
+{
+  GSList *l;
+
+  for (l = subscriptions; l; l = l->next)
+  {
+    manager_subscription *s = l->data;
+
+    if (s->cb == cb && s->user_data == user_data)
+      return s;
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Registers a callback for modem changes, the tracking starts with the
+ * first one. Only the interfaces some registered callback is interested in
+ * are watched, fetched and decoded, interfaces nobody needs any more are
+ * closed and their fields in the modem records reset to unknown. The modem
+ * properties are always tracked.
+ *
+ * @param cb Callback, receives #modem_changed
+ * @param user_data User data passed to @a cb
+ * @param cb_interests OFONO_MODEM_INTERFACE_* mask of the interfaces the
+ * callback needs, #OFONO_MODEM_INTERFACE_ALL for all of them
+ *
+ * @return FALSE if the tracking could not be started
+ */
+gboolean
+ofono_manager_modems_register_full(ofono_notify_fn cb, gpointer user_data,
+                                   guint64 cb_interests)
+{
+  manager_subscription *s = g_new(manager_subscription, 1);
+
+  s->cb = cb;
+  s->user_data = user_data;
+  s->interests = cb_interests;
+  subscriptions = g_slist_prepend(subscriptions, s);
+
+  /* before the tracking starts, so nothing is watched needlessly */
+  ofono_manager_update_interests();
+
+  if (!notifiers)
+  {
+    manager_call call = {0};
+
+    ready = FALSE;
+    call.generation = generation;
+    ofono_engine_call(ofono_manager_start_tracking, &call);
 
-      ofono_modem_close(path, ofono_modem_property_change_cb, m);
-      ofono_sim_close(path, ofono_sim_property_change_cb, m);
-      ofono_net_close(path, ofono_net_property_change_cb, m);
+    if (!call.rv)
+    {
+      ofono_notifier_close(&ready_notifiers, NULL, NULL);
+      ofono_manager_unsubscribe(NULL, NULL);
+      ofono_manager_update_interests();
+      return FALSE;
     }
+  }
 
-    modem_list_free(modems);
-    modems = NULL;
+  ofono_notifier_register(&notifiers, cb, user_data);
+
+  return TRUE;
+}
+
+gboolean
+ofono_manager_modems_register(ofono_notify_fn cb, gpointer user_data)
+{
+  return ofono_manager_modems_register_full(cb, user_data,
+                                            OFONO_MODEM_INTERFACE_ALL);
+}
+
+static manager_consumer *
+ofono_manager_consumer_find(ofono_notify_fn cb, gpointer user_data)
+{
+  GSList *l;
+
+  for (l = consumers; l; l = l->next)
+  {
+    manager_consumer *c = l->data;
+
+    if (c->cb == cb && c->user_data == user_data)
+      return c;
   }
+
+  return NULL;
 }
 
 static void
-ofono_manager_set_property_cb(DBusPendingCall *pending, void *user_data)
+ofono_manager_consumer_free(gpointer data)
 {
-  DBusMessage *reply;
-  set_property_data *data = user_data;
+  manager_consumer *c = data;
 
-  OFONO_ENTER
+  change_filter_free(c->filter);
+  g_free(c);
+}
+
+/* stands in for the notifier of a consumer with its own policies */
+static void
+ofono_manager_consumer_cb(const gpointer data, gpointer user_data)
+{
+  const modem_changed *mc = data;
+  manager_consumer *c = user_data;
+  modem_changed filtered = *mc;
+
+  if (mc->type == OFONO_MANAGER_MODEM_REMOVE)
+    change_filter_forget(c->filter, mc->modem->path);
+  else
+  {
+    filtered.changed = change_filter_apply(c->filter, mc->modem, mc->changed);
+
+    if (!filtered.changed)
+      return;
+  }
+
+  c->cb(&filtered, c->user_data);
+}
 
-  if (pending)
+/* consumers run on the notify context, which sees the published snapshot */
+static const modem *
+ofono_manager_consumer_lookup_cb(const gchar *path, gpointer user_data)
+{
+  GHashTable *snapshot;
+  const modem *m = NULL;
+
+  if (!ofono_engine_is_threaded())
+    return ofono_manager_policy_lookup_cb(path, user_data);
+
+  if ((snapshot = ofono_manager_get_modems_snapshot(NULL)))
   {
-    reply = dbus_pending_call_steal_reply(pending);
-    dbus_pending_call_unref(pending);
+    if ((m = g_hash_table_lookup(snapshot, path)))
+      modem_ref(m);
+
+    g_hash_table_unref(snapshot);
   }
 
-  if (pending && reply)
+  return m;
+}
+
+static void
+ofono_manager_consumer_deliver_cb(const modem *m, guint64 changed,
+                                  gpointer user_data)
+{
+  manager_consumer *c = user_data;
+  modem_changed mc;
+
+  mc.type = OFONO_MANAGER_MODEM_CHANGE;
+  mc.modem = m;
+  mc.changed = changed;
+  c->cb(&mc, c->user_data);
+}
+
+void
+ofono_manager_modems_close(ofono_notify_fn cb, gpointer user_data)
+{
+  manager_consumer *c;
+
+  if (!notifiers)
+    return;
+
+  if ((c = ofono_manager_consumer_find(cb, user_data)))
   {
-    if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
-    {
-      OFONO_WARN("SetProperty returned '%s'",
-                 dbus_message_get_error_name(reply));
+    consumers = g_slist_remove(consumers, c);
+    ofono_notifier_close(&notifiers, ofono_manager_consumer_cb, c);
+    ofono_manager_consumer_free(c);
+  }
+  else
+    ofono_notifier_close(&notifiers, cb, user_data);
 
-      if (data->cb)
-        data->cb(FALSE, data->user_data);
-    }
+  ofono_manager_unsubscribe(cb, user_data);
 
-    dbus_message_unref(reply);
+  if (!notifiers)
+  {
+    g_slist_free_full(consumers, ofono_manager_consumer_free);
+    consumers = NULL;
+    ofono_manager_unsubscribe(NULL, NULL);
+
+    /* whatever the engine still has queued belongs to this session */
+    generation++;
+    ofono_notifier_close(&ready_notifiers, NULL, NULL);
+    ready = FALSE;
+    ofono_engine_call(ofono_manager_stop_tracking, NULL);
   }
 
-  g_free(data);
+  ofono_manager_update_interests();
+}
 
-  OFONO_EXIT
+/**
+ * @brief Requests a single notification once the initial modem state is
+ * complete, i.e. GetModems and all the interface property requests it caused
+ * have been answered. The callback receives #modems_ready with the time
+ * elapsed since the first #ofono_manager_modems_register call. If the state is
+ * already complete, the callback is called immediately.
+ *
+ * @param cb Callback
+ * @param user_data User data passed to @a cb
+ */
+void
+ofono_manager_modems_ready(ofono_notify_fn cb, gpointer user_data)
+{
+  if (ready)
+    cb(&ready_result, user_data);
+  else
+    ofono_notifier_register(&ready_notifiers, cb, user_data);
+}
+
+static void
+ofono_manager_set_call_timeout_cb(gpointer data)
+{
+  manager_call *call = data;
+
+  ofono_iface_set_call_timeout(call->timeout);
+}
+
+/**
+ * @brief Sets how long the method calls sent to oFono may wait for a reply.
+ * A call that times out completes like a failed one. Calls that are still in
+ * flight when their object is no longer watched are cancelled regardless.
+ *
+ * @param timeout Timeout in milliseconds, -1 for the D-Bus default
+ */
+void
+ofono_manager_set_call_timeout(gint timeout)
+{
+  manager_call call = {0};
+
+  call.timeout = timeout;
+  ofono_engine_call(ofono_manager_set_call_timeout_cb, &call);
+}
+
+static void
+ofono_manager_set_coalesce_cb(gpointer data)
+{
+  manager_call *call = data;
+
+  coalesce_urgent = call->urgent;
+
+  if (coalesce && !call->enable && pending_changes_id)
+  {
+    ofono_engine_source_remove(pending_changes_id);
+    ofono_manager_flush_changes_idle(NULL);
+  }
+
+  coalesce = call->enable;
+}
+
+/**
+ * @brief Enables or disables coalescing of #OFONO_MANAGER_MODEM_CHANGE
+ * notifications. When enabled, changes of a modem are accumulated and
+ * delivered once from an idle callback with the union of the changed fields.
+ *
+ * @param enable TRUE to enable coalescing
+ * @param urgent OFONO_MODEM_CHANGED_* mask of fields that are delivered
+ * immediately, together with any changes queued for the same modem
+ */
+void
+ofono_manager_set_coalesce(gboolean enable, guint64 urgent)
+{
+  manager_call call = {0};
+
+  call.enable = enable;
+  call.urgent = urgent;
+  ofono_engine_call(ofono_manager_set_coalesce_cb, &call);
+}
+
+static void
+ofono_manager_set_hold_time_cb(gpointer data)
+{
+  manager_call *call = data;
+  hold_field *f = ofono_manager_hold_field(call->field);
+
+  if ((call->rv = f != NULL))
+    f->hold = call->hold;
 }
 
+/**
+ * @brief Sets how long a lost registration, roaming or attach state must last
+ * before it is published. Shorter flaps, e.g. "searching" during a handover,
+ * are absorbed and only show up in the statistics. Regaining a state is always
+ * published right away.
+ *
+ * @param field #OFONO_MODEM_CHANGED_NET_REGISTERED,
+ * #OFONO_MODEM_CHANGED_NET_ROAMING or #OFONO_MODEM_CHANGED_CONN_ATTACHED. Any
+ * change of the roaming state counts as a flap.
+ * @param hold Hold time in milliseconds, 0 to publish every change right away
+ *
+ * @return FALSE if @a field can not be held
+ */
 gboolean
-ofono_manager_set_property(const char *path, const char *iface,
-                           const char *property, int type, void *value,
-                           ofono_property_set_fn cb, gpointer user_data)
+ofono_manager_set_hold_time(guint64 field, guint hold)
 {
-  DBusMessage *message;
-  gboolean rv = FALSE;
+  manager_call call = {0};
 
-  OFONO_ENTER
+  call.field = field;
+  call.hold = hold;
+  ofono_engine_call(ofono_manager_set_hold_time_cb, &call);
 
-  message = dbus_message_new_method_call(OFONO_SERVICE, path, iface,
-                                         "SetProperty");
+  return call.rv;
+}
 
-  if (message)
+static void
+ofono_manager_get_hold_stats_cb(gpointer data)
+{
+  manager_call *call = data;
+  hold_field *f = ofono_manager_hold_field(call->field);
+
+  if ((call->rv = f != NULL))
+    *call->stats = f->stats;
+}
+
+/**
+ * @brief Gets the statistics of a state that can be held, they are kept
+ * whether a hold time is set or not
+ *
+ * @param field See #ofono_manager_set_hold_time
+ * @param stats Return location for the statistics
+ *
+ * @return FALSE if @a field can not be held
+ */
+gboolean
+ofono_manager_get_hold_stats(guint64 field, hold_stats *stats)
+{
+  manager_call call = {0};
+
+  call.field = field;
+  call.stats = stats;
+  ofono_engine_call(ofono_manager_get_hold_stats_cb, &call);
+
+  return call.rv;
+}
+
+static void
+ofono_manager_set_change_policy_cb(gpointer data)
+{
+  manager_call *call = data;
+
+  if (!policy_filter)
   {
-    DBusMessageIter iter;
+    policy_filter = change_filter_new(ofono_engine_get_context,
+                                      ofono_manager_policy_lookup_cb,
+                                      ofono_manager_policy_deliver_cb, NULL);
+  }
 
-    dbus_message_iter_init_append(message, &iter);
+  change_filter_set_policy(policy_filter, call->desc, call->policy);
+}
 
-    if (dbus_helper_append_property(&iter, property, type, value))
-    {
-      set_property_data *data = g_new0(set_property_data, 1);
+/**
+ * @brief Limits the notifications of a property, e.g. to keep the signal
+ * strength from waking consumers up all the time. Policies set for all
+ * consumers apply before the ones of a single consumer and before
+ * coalescing.
+ *
+ * @param cb Callback registered with #ofono_manager_modems_register, or NULL
+ * to set the policy for all consumers
+ * @param user_data User data of @a cb
+ * @param interface One of OFONO_MODEM_INTERFACE_* or 0 for the modem itself
+ * @param property Property name
+ * @param policy The policy, copied, or NULL to notify every change again
+ *
+ * @return FALSE if the property is not tracked or @a cb is not registered
+ */
+gboolean
+ofono_manager_set_change_policy(ofono_notify_fn cb, gpointer user_data,
+                                guint64 interface, const char *property,
+                                const change_policy *policy)
+{
+  ofono_iface_type type = ofono_manager_interface_type(interface);
+  const property_desc *desc = NULL;
+  manager_consumer *c;
 
-      data->cb = cb;
-      data->user_data = user_data;
+  if (type != OFONO_IFACE_LAST)
+    desc = property_lookup(type, property);
 
-      if (icd_dbus_send_system_mcall(message, -1,
-                                     ofono_manager_set_property_cb, data))
-      {
-        rv = TRUE;
-      }
-      else
-      {
-        OFONO_ERR("could not send 'SetProperty' method call");
-        g_free(data);
-      }
+  if (!desc)
+    return FALSE;
 
-      dbus_message_unref(message);
-    }
-    else
-      OFONO_ERR("could not create 'SetProperty' method call");
+  if (!cb)
+  {
+    manager_call call = {0};
+
+    call.desc = desc;
+    call.policy = policy;
+    ofono_engine_call(ofono_manager_set_change_policy_cb, &call);
+
+    return TRUE;
   }
-  else
-    OFONO_ERR("could not append 'SetProperty' data");
 
-  OFONO_EXIT
+  if (!(c = ofono_manager_consumer_find(cb, user_data)))
+  {
+    /* every registered callback has a subscription */
+    if (!ofono_manager_subscription_find(cb, user_data))
+      return FALSE;
+
+    if (!policy)
+      return TRUE;
+
+    /* the consumer gets its notifications through its filter from now on */
+    c = g_new(manager_consumer, 1);
+    c->cb = cb;
+    c->user_data = user_data;
+    c->filter = change_filter_new(ofono_engine_get_notify_context,
+                                  ofono_manager_consumer_lookup_cb,
+                                  ofono_manager_consumer_deliver_cb, c);
+    consumers = g_slist_prepend(consumers, c);
+
+    ofono_notifier_close(&notifiers, cb, user_data);
+    ofono_notifier_register(&notifiers, ofono_manager_consumer_cb, c);
+  }
 
-  return rv;
+  change_filter_set_policy(c->filter, desc, policy);
+
+  return TRUE;
 }
 
+/**
+ * @brief Powers the modem on or off
+ *
+ * @param path Modem object path
+ * @param on TRUE to power on
+ * @param cb Called once when the write completed, with TRUE on success
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE if the write was sent or queued, @a cb is not called otherwise
+ */
 gboolean
 ofono_manager_modem_set_power(const char *path, dbus_bool_t on,
                               ofono_property_set_fn cb, gpointer user_data)
 {
-  return ofono_manager_set_property(path, OFONO_MODEM_INTERFACE, "Powered",
-                                    DBUS_TYPE_BOOLEAN, &on, cb, user_data);
+  return ofono_write_property(path, OFONO_IFACE_MODEM, "Powered",
+                              DBUS_TYPE_BOOLEAN, &on, cb, user_data);
 }
 
 gboolean
 ofono_manager_modem_set_online(const char *path, dbus_bool_t on,
                                ofono_property_set_fn cb, gpointer user_data)
 {
-  return ofono_manager_set_property(path, OFONO_MODEM_INTERFACE, "Online",
-                                  DBUS_TYPE_BOOLEAN, &on, cb, user_data);
+  return ofono_write_property(path, OFONO_IFACE_MODEM, "Online",
+                              DBUS_TYPE_BOOLEAN, &on, cb, user_data);
+}
+
+/**
+ * @brief Same as #ofono_manager_modem_set_power, but the callback gets the
+ * D-Bus error name and the round-trip time of the write as well
+ *
+ * @param path Modem object path
+ * @param on TRUE to power on
+ * @param cb Called once with #property_set_result
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE if the write was sent or queued, @a cb is not called otherwise
+ */
+gboolean
+ofono_manager_modem_set_power_full(const char *path, dbus_bool_t on,
+                                   ofono_property_set_result_fn cb,
+                                   gpointer user_data)
+{
+  return ofono_write_property_full(path, OFONO_IFACE_MODEM, "Powered",
+                                   DBUS_TYPE_BOOLEAN, &on, cb, user_data);
+}
+
+gboolean
+ofono_manager_modem_set_online_full(const char *path, dbus_bool_t on,
+                                    ofono_property_set_result_fn cb,
+                                    gpointer user_data)
+{
+  return ofono_write_property_full(path, OFONO_IFACE_MODEM, "Online",
+                                   DBUS_TYPE_BOOLEAN, &on, cb, user_data);
+}
+
+/**
+ * @brief Sets any property of a modem interface, see #ofono_manager_modem_set_power
+ * for how the write completes
+ *
+ * @param path Modem object path
+ * @param interface One of OFONO_MODEM_INTERFACE_* or 0 for the modem itself
+ * @param property Property name
+ * @param type D-Bus type of the value, any basic type but DBUS_TYPE_UNIX_FD,
+ * or DBUS_TYPE_ARRAY for an array of strings
+ * @param value Pointer to the value, as for dbus_message_iter_append_basic(),
+ * for DBUS_TYPE_ARRAY a pointer to a NULL terminated string vector
+ * @param cb Called once with #property_set_result, can be NULL
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE if the write was sent or queued, @a cb is not called otherwise
+ */
+gboolean
+ofono_manager_modem_set_property(const char *path, guint64 interface,
+                                 const char *property, int type,
+                                 const void *value,
+                                 ofono_property_set_result_fn cb,
+                                 gpointer user_data)
+{
+  ofono_iface_type iface = ofono_manager_interface_type(interface);
+
+  if (iface == OFONO_IFACE_LAST)
+  {
+    OFONO_ERR("Unsupported interface 0x%" G_GINT64_MODIFIER "x of %s",
+              interface, path);
+    return FALSE;
+  }
+
+  return ofono_write_property_full(path, iface, property, type, value, cb,
+                                   user_data);
+}
+
+/**
+ * @brief Runs the tracking engine in its own thread, on its own main context
+ * and system bus connection. Notifications and write results are delivered on
+ * @a context instead, the API must be called from there as well, apart from
+ * #ofono_manager_get_modems_snapshot which works from any thread. Must be
+ * called before #ofono_manager_modems_register.
+ *
+ * @param context Context to deliver notifications on, NULL for the thread
+ * default context of the caller
+ * @param error Return location for the error or NULL
+ *
+ * @return TRUE if the engine thread is running
+ */
+gboolean
+ofono_manager_start_thread(GMainContext *context, GError **error)
+{
+  if (notifiers)
+  {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                        "Modems are already tracked");
+    return FALSE;
+  }
+
+  return ofono_engine_start(context, error);
+}
+
+/**
+ * @brief Stops the engine thread started by #ofono_manager_start_thread, the
+ * engine runs on the default main context again. Must be called after the
+ * last #ofono_manager_modems_close.
+ */
+void
+ofono_manager_stop_thread(void)
+{
+  g_return_if_fail(!notifiers);
+
+  ofono_engine_stop();
+  ofono_manager_published_reclaim();
 }
@@ -1,3 +1,8 @@
+#ifndef __ICD_OFONO_MANAGER_H__
+#define __ICD_OFONO_MANAGER_H__
+
+#include <gio/gio.h>
+
 #include "modem.h"
 #include "notifier.h"
 
@@ -11,20 +16,152 @@ enum ofono_manager_modem_change
   OFONO_MANAGER_MODEM_REMOVE
 };
 
+#define OFONO_MODEM_CHANGED_POWERED                        0x0000000000000001LL
+#define OFONO_MODEM_CHANGED_ONLINE                         0x0000000000000002LL
+#define OFONO_MODEM_CHANGED_EMERGENCY                      0x0000000000000004LL
+#define OFONO_MODEM_CHANGED_IMEI                           0x0000000000000008LL
+#define OFONO_MODEM_CHANGED_INTERFACES                     0x0000000000000010LL
+#define OFONO_MODEM_CHANGED_SIM_PRESENT                    0x0000000000000020LL
+#define OFONO_MODEM_CHANGED_SIM_IMSI                       0x0000000000000040LL
+#define OFONO_MODEM_CHANGED_SIM_SPN                        0x0000000000000080LL
+#define OFONO_MODEM_CHANGED_NET_REGISTERED                 0x0000000000000100LL
+#define OFONO_MODEM_CHANGED_NET_ROAMING                    0x0000000000000200LL
+#define OFONO_MODEM_CHANGED_NET_NAME                       0x0000000000000400LL
+#define OFONO_MODEM_CHANGED_CONN_ATTACHED                  0x0000000000000800LL
+#define OFONO_MODEM_CHANGED_CONN_BEARER                    0x0000000000001000LL
+#define OFONO_MODEM_CHANGED_CONN_POWERED                   0x0000000000002000LL
+#define OFONO_MODEM_CHANGED_CONN_ROAMING_ALLOWED           0x0000000000004000LL
+#define OFONO_MODEM_CHANGED_CONN_SUSPENDED                 0x0000000000008000LL
+/* a context was added or removed or any of its properties changed */
+#define OFONO_MODEM_CHANGED_CONTEXTS                       0x0000000000010000LL
+#define OFONO_MODEM_CHANGED_NET_STATUS                     0x0000000000020000LL
+#define OFONO_MODEM_CHANGED_NET_TECHNOLOGY                 0x0000000000040000LL
+#define OFONO_MODEM_CHANGED_NET_STRENGTH                   0x0000000000080000LL
+#define OFONO_MODEM_CHANGED_NET_LAC                        0x0000000000100000LL
+#define OFONO_MODEM_CHANGED_NET_CELL_ID                    0x0000000000200000LL
+#define OFONO_MODEM_CHANGED_NET_MCC                        0x0000000000400000LL
+#define OFONO_MODEM_CHANGED_NET_MNC                        0x0000000000800000LL
+#define OFONO_MODEM_CHANGED_LTE_APN                        0x0000000001000000LL
+#define OFONO_MODEM_CHANGED_LTE_PROTOCOL                   0x0000000002000000LL
+#define OFONO_MODEM_CHANGED_LTE_AUTH_METHOD                0x0000000004000000LL
+#define OFONO_MODEM_CHANGED_LTE_USERNAME                   0x0000000008000000LL
+/* set along with OFONO_MODEM_CHANGED_CONTEXTS, the property that changed in
+ * any of the contexts */
+#define OFONO_MODEM_CHANGED_CONTEXT_ACTIVE                 0x0000000010000000LL
+#define OFONO_MODEM_CHANGED_CONTEXT_APN                    0x0000000020000000LL
+#define OFONO_MODEM_CHANGED_CONTEXT_TYPE                   0x0000000040000000LL
+#define OFONO_MODEM_CHANGED_CONTEXT_PROTOCOL               0x0000000080000000LL
+#define OFONO_MODEM_CHANGED_CONTEXT_NAME                   0x0000000100000000LL
+#define OFONO_MODEM_CHANGED_CONTEXT_SETTINGS               0x0000000200000000LL
+#define OFONO_MODEM_CHANGED_CONTEXT_IPV6_SETTINGS          0x0000000400000000LL
+
+#define OFONO_MODEM_CHANGED_ALL                            0xFFFFFFFFFFFFFFFFLL
+
 struct _modem_changed
 {
   enum ofono_manager_modem_change type;
+  /** current record, never modified once seen, #modem_ref keeps it */
   const modem *modem;
+  /** OFONO_MODEM_CHANGED_* mask of the fields that changed, all bits are set
+   * for #OFONO_MANAGER_MODEM_ADD and #OFONO_MANAGER_MODEM_REMOVE */
+  guint64 changed;
 };
 
 typedef struct _modem_changed modem_changed;
 
+struct _modems_ready
+{
+  /** whether GetModems succeeded */
+  gboolean success;
+  /** time from the start of the tracking until the state was complete, in
+   * microseconds */
+  gint64 elapsed;
+};
+
+typedef struct _modems_ready modems_ready;
+
+/** @brief How the changes of a single property are notified. Only the
+ * notifications are limited, the modem records always hold the current
+ * values. */
+struct _change_policy
+{
+  /** minimum time between two notifications of the property, in
+   * milliseconds, 0 for no limit */
+  guint interval;
+  /** numeric properties only: changes smaller than this, compared to the
+   * value last notified, are not notified, 0 to notify every change */
+  guint deadband;
+  /** changes within @a interval are notified once it has elapsed, with the
+   * latest value, instead of being dropped */
+  gboolean latest;
+};
+
+typedef struct _change_policy change_policy;
+
+/** @brief Statistics of a state protected by a hold time, see
+ * #ofono_manager_set_hold_time */
+struct _hold_stats
+{
+  /** changes of the state reported by oFono, published or not */
+  guint transitions;
+  /** losses held back */
+  guint held;
+  /** held losses that recovered within the hold time and were never
+   * published */
+  guint absorbed;
+  /** held losses published once the hold time elapsed, or replaced by a
+   * change that is not held */
+  guint published;
+};
+
+typedef struct _hold_stats hold_stats;
+
 typedef void (*ofono_property_set_fn)(gboolean success, gpointer user_data);
 
+/* error name of writes cancelled because the object is no longer watched */
+#define OFONO_PROPERTY_SET_ERROR_CANCELLED "org.maemo.libofono.Error.Cancelled"
+
+struct _property_set_result
+{
+  gboolean success;
+  /** D-Bus error name, NULL on success */
+  const char *error_name;
+  /** time from sending the SetProperty call until its reply, in
+   * microseconds, 0 if the call was never answered */
+  gint64 rtt;
+  /** time from the request until its completion, in microseconds */
+  gint64 elapsed;
+};
+
+typedef struct _property_set_result property_set_result;
+
+typedef void (*ofono_property_set_result_fn)(const property_set_result *result, gpointer user_data);
+
 gboolean ofono_manager_modems_register(ofono_notify_fn cb, gpointer user_data);
-gboolean ofono_manager_get_modems_sync(void);
+gboolean ofono_manager_modems_register_full(ofono_notify_fn cb, gpointer user_data, guint64 cb_interests);
+G_GNUC_DEPRECATED gboolean ofono_manager_get_modems_sync(void);
+gboolean ofono_manager_get_modems_sync_timeout(gint timeout, GError **error);
+void ofono_manager_get_modems_async(GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean ofono_manager_get_modems_finish(GAsyncResult *result, GError **error);
 GHashTable *ofono_manager_get_modems(void);
+GHashTable *ofono_manager_get_modems_snapshot(guint64 *version);
 void ofono_manager_modems_close(ofono_notify_fn cb, gpointer user_data);
+void ofono_manager_modems_ready(ofono_notify_fn cb, gpointer user_data);
+void ofono_manager_set_call_timeout(gint timeout);
+void ofono_manager_set_coalesce(gboolean enable, guint64 urgent);
+gboolean ofono_manager_set_hold_time(guint64 field, guint hold);
+gboolean ofono_manager_get_hold_stats(guint64 field, hold_stats *stats);
+gboolean ofono_manager_set_change_policy(ofono_notify_fn cb, gpointer user_data, guint64 interface, const char *property, const change_policy *policy);
+gboolean ofono_manager_start_thread(GMainContext *context, GError **error);
+void ofono_manager_stop_thread(void);
+
+void ofono_manager_modem_fetch_async(const char *path, guint64 interface, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean ofono_manager_modem_fetch_finish(GAsyncResult *result, GError **error);
 
 gboolean ofono_manager_modem_set_power(const gchar *path, dbus_bool_t on, ofono_property_set_fn cb, gpointer user_data);
 gboolean ofono_manager_modem_set_online(const char *path, dbus_bool_t on, ofono_property_set_fn cb, gpointer user_data);
+gboolean ofono_manager_modem_set_power_full(const gchar *path, dbus_bool_t on, ofono_property_set_result_fn cb, gpointer user_data);
+gboolean ofono_manager_modem_set_online_full(const char *path, dbus_bool_t on, ofono_property_set_result_fn cb, gpointer user_data);
+gboolean ofono_manager_modem_set_property(const char *path, guint64 interface, const char *property, int type, const void *value, ofono_property_set_result_fn cb, gpointer user_data);
+
+#endif /* __ICD_OFONO_MANAGER_H__ */
@@ -1,276 +1,164 @@
 #include <glib.h>
 
-#include <string.h>
-
 #include "ofono-modem.h"
+#include "ofono-iface.h"
 #include "log.h"
 #include "dbus-helpers.h"
-#include "modem.h"
-
-static GHashTable *modems = NULL;
+#include "property.h"
 
-static void
-ofono_modem_notifier_notify(const char *path, gpointer data)
+struct _modem_interface
 {
-  GSList *notifiers = NULL;
+  const char *name;
+  guint64 mask;
+};
 
-  if (modems)
-    notifiers = g_hash_table_lookup(modems, path);
+typedef struct _modem_interface modem_interface;
 
-  if (notifiers)
-    ofono_notifier_notify(notifiers, data);
-}
+#define MODEM_INTERFACE(_name, _mask) \
+  {"org.ofono." _name, OFONO_MODEM_INTERFACE_##_mask}
 
-static gboolean
-ofono_modem_property_changed(const char *path, DBusMessageIter *iter)
+/* every interface oFono can list in "Interfaces", the bits are part of the
+ * API and never reused */
+static const modem_interface modem_interfaces[] =
 {
-  property_changed pc;
-  gboolean rv = FALSE;
+  MODEM_INTERFACE("SimManager", SIM_MANAGER),
+  MODEM_INTERFACE("LongTermEvolution", LTE),
+  MODEM_INTERFACE("NetworkRegistration", NETWORK_REGISTRATION),
+  MODEM_INTERFACE("ConnectionManager", CONNECTION_MANAGER),
+  MODEM_INTERFACE("AssistedSatelliteNavigation", ASSISTED_NAVIGATION),
+  MODEM_INTERFACE("AudioSettings", AUDIO_SETTINGS),
+  MODEM_INTERFACE("CallBarring", CALL_BARRING),
+  MODEM_INTERFACE("CallForwarding", CALL_FORWARDING),
+  MODEM_INTERFACE("CallMeter", CALL_METER),
+  MODEM_INTERFACE("CallSettings", CALL_SETTINGS),
+  MODEM_INTERFACE("CallVolume", CALL_VOLUME),
+  MODEM_INTERFACE("CellBroadcast", CELL_BROADCAST),
+  MODEM_INTERFACE("Handsfree", HANDSFREE),
+  MODEM_INTERFACE("IpMultimediaSystem", IP_MULTIMEDIA_SYSTEM),
+  MODEM_INTERFACE("LocationReporting", LOCATION_REPORTING),
+  MODEM_INTERFACE("MessageManager", MESSAGE_MANAGER),
+  MODEM_INTERFACE("MessageWaiting", MESSAGE_WAITING),
+  MODEM_INTERFACE("NetworkMonitor", NETWORK_MONITOR),
+  MODEM_INTERFACE("Phonebook", PHONEBOOK),
+  MODEM_INTERFACE("PushNotification", PUSH_NOTIFICATION),
+  MODEM_INTERFACE("RadioSettings", RADIO_SETTINGS),
+  MODEM_INTERFACE("SimAuthentication", SIM_AUTHENTICATION),
+  MODEM_INTERFACE("SimToolkit", SIM_TOOLKIT),
+  MODEM_INTERFACE("Siri", SIRI),
+  MODEM_INTERFACE("SmartMessaging", SMART_MESSAGING),
+  MODEM_INTERFACE("SupplementaryServices", SUPPLEMENTARY_SERVICES),
+  MODEM_INTERFACE("TextTelephony", TEXT_TELEPHONY),
+  MODEM_INTERFACE("VoiceCallManager", VOICE_CALL_MANAGER),
+  MODEM_INTERFACE("AllowedAccessPoints", ALLOWED_ACCESS_POINTS),
+  MODEM_INTERFACE("cdma.ConnectionManager", CDMA_CONNECTION_MANAGER),
+  MODEM_INTERFACE("cdma.MessageManager", CDMA_MESSAGE_MANAGER),
+  MODEM_INTERFACE("cdma.NetworkRegistration", CDMA_NETWORK_REGISTRATION),
+  MODEM_INTERFACE("cdma.VoiceCallManager", CDMA_VOICE_CALL_MANAGER)
+};
+
+/* interface name -> modem_interface, built on first use, which may come
+ * from the engine thread as well as from the caller thread */
+static GOnce modem_interface_once = G_ONCE_INIT;
+static GHashTable *modem_interface_index = NULL;
+
+static gpointer
+ofono_modem_interface_index_init(gpointer data)
+{
+  guint i;
 
-  OFONO_ENTER
+  modem_interface_index = g_hash_table_new(g_str_hash, g_str_equal);
 
-  if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_STRING)
+  for (i = 0; i < G_N_ELEMENTS(modem_interfaces); i++)
   {
-    dbus_message_iter_get_basic(iter, &pc.property);
-
-    if (!strcmp(pc.property, "Interfaces"))
-    {
-      pc.val.u64 = 0;
-      dbus_message_iter_next(iter);
-
-      if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_VARIANT)
-      {
-        DBusMessageIter variant_iter;
-
-        dbus_message_iter_recurse(iter, &variant_iter);
-
-        if (dbus_message_iter_get_arg_type(&variant_iter) == DBUS_TYPE_ARRAY)
-        {
-          DBusMessageIter array_iter;
-
-          dbus_message_iter_recurse(&variant_iter, &array_iter);
-
-          while (dbus_message_iter_get_arg_type(&array_iter) ==
-                 DBUS_TYPE_STRING)
-          {
-            const char *iface;
-
-            dbus_message_iter_get_basic(&array_iter, &iface);
-
-            if (!strcmp(iface, "org.ofono.SimManager"))
-                pc.val.u64 |= OFONO_MODEM_INTERFACE_SIM_MANAGER;
-            else if (!strcmp(iface, "org.ofono.LongTermEvolution"))
-                pc.val.u64 |= OFONO_MODEM_INTERFACE_LTE;
-            else if (!strcmp(iface, "org.ofono.NetworkRegistration"))
-                pc.val.u64 |= OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION;
-            else if (!strcmp(iface, "org.ofono.ConnectionManager"))
-                pc.val.u64 |= OFONO_MODEM_INTERFACE_CONNECTION_MANAGER;
-
-            dbus_message_iter_next(&array_iter);
-          }
-
-          ofono_modem_notifier_notify(path, &pc);
-        }
-      }
-    }
-    else
-    {
-      int type = dbus_helper_read_basic_property(iter, &pc.property, &pc.val);
-
-      if (type != DBUS_TYPE_INVALID)
-      {
-        if (dbus_helper_is_basic_type(type))
-          ofono_modem_notifier_notify(path, &pc);
-
-        rv = TRUE;
-      }
-    }
+    g_hash_table_insert(modem_interface_index,
+                        (gpointer)modem_interfaces[i].name,
+                        (gpointer)&modem_interfaces[i]);
   }
 
-  OFONO_EXIT
-
-  return rv;
+  return data;
 }
 
-static void
-ofono_modem_get_properties_cb(DBusPendingCall *pending, void *user_data)
+static dbus_uint64_t
+ofono_modem_read_interfaces(DBusMessageIter *iter)
 {
-  DBusMessage *reply;
-  gchar *path = user_data;
+  dbus_uint64_t interfaces = 0;
+  DBusMessageIter array_iter;
 
-  OFONO_ENTER
+  g_once(&modem_interface_once, ofono_modem_interface_index_init, NULL);
 
-  if (pending)
-  {
-    reply = dbus_pending_call_steal_reply(pending);
-    dbus_pending_call_unref(pending);
-  }
+  dbus_message_iter_recurse(iter, &array_iter);
 
-  if (pending && reply)
+  while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRING)
   {
-    if (dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_ERROR)
-    {
-      DBusMessageIter iter;
-
-      dbus_message_iter_init(reply, &iter);
-
-      if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
-      {
-        DBusMessageIter array_iter;
-
-        dbus_message_iter_recurse(&iter, &array_iter);
+    const char *name;
+    const modem_interface *iface;
 
-        while (dbus_message_iter_get_arg_type(&array_iter) ==
-               DBUS_TYPE_DICT_ENTRY)
-        {
-          DBusMessageIter dict_iter;
+    dbus_message_iter_get_basic(&array_iter, &name);
+    iface = g_hash_table_lookup(modem_interface_index, name);
 
-          dbus_message_iter_recurse(&array_iter, &dict_iter);
-          ofono_modem_property_changed(path, &dict_iter);
-
-          dbus_message_iter_next(&array_iter);
-        }
-      }
-    }
+    if (iface)
+      interfaces |= iface->mask;
     else
-    {
-      OFONO_WARN("GetProperties returned '%s'",
-                 dbus_message_get_error_name(reply));
-    }
+      OFONO_DEBUG("Unknown modem interface %s", name);
 
-    dbus_message_unref(reply);
+    dbus_message_iter_next(&array_iter);
   }
 
-  g_free(path);
-
-  OFONO_EXIT
+  return interfaces;
 }
 
-static gboolean
-ofono_modem_init(const char *path)
+/**
+ * @brief Decodes a single org.ofono.Modem property. "Interfaces" is returned
+ * as a bitmask of OFONO_MODEM_INTERFACE_* values in @a pc->val.u64.
+ *
+ * @param iter Iterator pointing to the property name
+ * @param pc Decoded property
+ *
+ * @return D-Bus type of the value or DBUS_TYPE_INVALID if it cannot be decoded
+ */
+int
+ofono_modem_read_property(DBusMessageIter *iter, property_changed *pc)
 {
-  DBusMessage *message;
-  gboolean rv = FALSE;
-  OFONO_ENTER
+  int type;
 
-  message = dbus_message_new_method_call(OFONO_SERVICE, path,
-                                         OFONO_MODEM_INTERFACE,
-                                         "GetProperties");
+  type = dbus_helper_read_basic_property(iter, &pc->property, &pc->val);
 
-  if (message)
+  if (type == DBUS_TYPE_ARRAY)
   {
-    gchar *_path = g_strdup(path);
-
-    if (icd_dbus_send_system_mcall(message, -1, ofono_modem_get_properties_cb,
-                                   _path))
-    {
-      rv = TRUE;
-    }
-    else
-    {
-      g_free(_path);
-      OFONO_ERR("could not send 'GetProperties' message");
-    }
-
-    dbus_message_unref(message);
-  }
-  else
-    OFONO_ERR("could not create 'GetProperties' method call");
-
-  OFONO_EXIT
+    const property_desc *desc;
 
-  return rv;
-}
-
-static DBusHandlerResult
-ofono_modem_filter(DBusConnection *connection, DBusMessage *message,
-                   void *user_data)
-{
-  OFONO_ENTER
+    desc = property_lookup(OFONO_IFACE_MODEM, pc->property);
 
-  if (dbus_message_is_signal(message,
-                             OFONO_MODEM_INTERFACE,
-                             "PropertyChanged"))
-  {
-    DBusMessageIter iter;
+    if (desc && desc->type == PROPERTY_TYPE_MASK)
+    {
+      DBusMessageIter variant_iter;
 
-    if (dbus_message_iter_init(message, &iter))
-      ofono_modem_property_changed(dbus_message_get_path(message), &iter);
+      dbus_message_iter_recurse(iter, &variant_iter);
+      pc->val.u64 = ofono_modem_read_interfaces(&variant_iter);
+    }
     else
-      OFONO_WARN("Invalid arguments for PropertyChanged signal");
+      type = DBUS_TYPE_INVALID;
   }
+  else if (!dbus_helper_is_basic_type(type))
+    type = DBUS_TYPE_INVALID;
 
-  OFONO_EXIT
-
-  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-}
-
-static gboolean
-ofono_modem_add_dbus_filter()
-{
-  return icd_dbus_connect_system_bcast_signal(
-        OFONO_MODEM_INTERFACE, ofono_modem_filter, NULL, NULL);
+  return type;
 }
 
-static void
-ofono_modem_remove_dbus_filter()
+gboolean
+ofono_modem_register(const char *path, ofono_notify_fn cb, gpointer user_data)
 {
-  icd_dbus_disconnect_system_bcast_signal(
-    OFONO_MODEM_INTERFACE, ofono_modem_filter, NULL, NULL);
+  return ofono_iface_register(path, OFONO_IFACE_MODEM, cb, user_data);
 }
 
 gboolean
-ofono_modem_register(const char *path, ofono_notify_fn cb, gpointer user_data)
+ofono_modem_watch(const char *path, ofono_notify_fn cb, gpointer user_data)
 {
-  gboolean rv = TRUE;
-  GSList *notifiers;
-
-  if (!modems)
-    modems = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-
-  notifiers = g_hash_table_lookup(modems, path);
-
-  if (!notifiers)
-  {
-    if ((rv = ofono_modem_init(path)))
-        rv = ofono_modem_add_dbus_filter();
-  }
-
-  if (rv)
-  {
-    ofono_notifier_register(&notifiers, cb, user_data);
-    g_hash_table_insert(modems, g_strdup(path), notifiers);
-  }
-
-  return rv;
+  return ofono_iface_watch(path, OFONO_IFACE_MODEM, cb, user_data);
 }
 
 void
 ofono_modem_close(const char *path, ofono_notify_fn cb, gpointer user_data)
 {
-  GSList *notifiers;
-
-  if (!modems)
-      return;
-
-  notifiers = g_hash_table_lookup(modems, path);
-
-  if (notifiers)
-  {
-    ofono_notifier_close(&notifiers, cb, user_data);
-
-    if (!notifiers)
-    {
-      g_hash_table_remove(modems, path);
-
-      if (!g_hash_table_size(modems))
-      {
-        ofono_modem_remove_dbus_filter();
-        g_hash_table_unref(modems);
-        modems = NULL;
-      }
-    }
-    else
-      g_hash_table_insert(modems, g_strdup(path), notifiers);
-  }
+  ofono_iface_close(path, OFONO_IFACE_MODEM, cb, user_data);
 }
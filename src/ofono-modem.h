@@ -1,5 +1,9 @@
 #include <ofono/dbus.h>
 #include "notifier.h"
+#include "modem.h"
+
+int ofono_modem_read_property(DBusMessageIter *iter, property_changed *pc);
 
 gboolean ofono_modem_register(const char *path, ofono_notify_fn cb, gpointer user_data);
+gboolean ofono_modem_watch(const char *path, ofono_notify_fn cb, gpointer user_data);
 void ofono_modem_close(const char *path, ofono_notify_fn cb, gpointer user_data);
@@ -0,0 +1,531 @@
+#include <glib.h>
+
+#include <string.h>
+
+#include "ofono-write.h"
+#include "ofono-engine.h"
+#include "string-pool.h"
+#include "dbus-helpers.h"
+#include "log.h"
+
+struct _write_value
+{
+  int type;
+  /** strings are owned */
+  DBusBasicValue val;
+  /** owned string vector of DBUS_TYPE_ARRAY values */
+  gchar **strv;
+};
+
+typedef struct _write_value write_value;
+
+struct _write_waiter
+{
+  ofono_property_set_fn cb;
+  ofono_property_set_result_fn result_cb;
+  gpointer user_data;
+  /** monotonic time of the request */
+  gint64 requested;
+};
+
+typedef struct _write_waiter write_waiter;
+
+/** @brief A completed write handed over to the notification context */
+struct _write_completion
+{
+  write_waiter *waiter;
+  property_set_result result;
+  gchar *error_name;
+};
+
+typedef struct _write_completion write_completion;
+
+/** @brief A write request run on the engine context */
+struct _write_call
+{
+  const char *path;
+  ofono_iface_type iface;
+  const char *property;
+  int type;
+  const void *value;
+  const write_waiter *waiter;
+  gboolean rv;
+};
+
+typedef struct _write_call write_call;
+
+/** @brief Writes of a single (path, interface, property), exists while a
+ * SetProperty call is in flight */
+struct _write_queue
+{
+  gchar *key;
+  /** pooled */
+  const gchar *path;
+  ofono_iface_type iface;
+  /** pooled */
+  const gchar *property;
+  /** value of the call in flight and the callers it completes */
+  write_value current;
+  GSList *current_waiters;
+  /** monotonic time the call in flight was sent */
+  gint64 sent;
+  /** value to write once the call in flight completes, last writer wins */
+  gboolean has_next;
+  write_value next;
+  GSList *next_waiters;
+};
+
+typedef struct _write_queue write_queue;
+
+/* "path interface.property" -> write_queue */
+static GHashTable *queues = NULL;
+
+#define ofono_write_is_string_type(t) \
+  ((t) == DBUS_TYPE_STRING || (t) == DBUS_TYPE_OBJECT_PATH || \
+   (t) == DBUS_TYPE_SIGNATURE)
+
+/* size of fixed length values, 0 for the rest */
+static gsize
+ofono_write_fixed_size(int type)
+{
+  switch (type)
+  {
+    case DBUS_TYPE_BYTE:
+      return sizeof(unsigned char);
+    case DBUS_TYPE_BOOLEAN:
+      return sizeof(dbus_bool_t);
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+      return sizeof(dbus_uint16_t);
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+      return sizeof(dbus_uint32_t);
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+      return sizeof(dbus_uint64_t);
+    case DBUS_TYPE_DOUBLE:
+      return sizeof(double);
+  }
+
+  return 0;
+}
+
+/* file descriptors are not supported, a queued write would outlive them */
+static gboolean
+ofono_write_type_supported(int type)
+{
+  return ofono_write_fixed_size(type) || ofono_write_is_string_type(type) ||
+      type == DBUS_TYPE_ARRAY;
+}
+
+static void
+ofono_write_value_set(write_value *v, int type, const void *value)
+{
+  memset(&v->val, 0, sizeof(v->val));
+  v->type = type;
+  v->strv = NULL;
+
+  if (type == DBUS_TYPE_ARRAY)
+    v->strv = g_strdupv(*(gchar **const *)value);
+  else if (ofono_write_is_string_type(type))
+    v->val.str = g_strdup(*(const char *const *)value);
+  else if (type == DBUS_TYPE_BOOLEAN)
+    v->val.bool_val = *(const dbus_bool_t *)value ? TRUE : FALSE;
+  else
+    memcpy(&v->val, value, ofono_write_fixed_size(type));
+}
+
+static void
+ofono_write_value_clear(write_value *v)
+{
+  if (ofono_write_is_string_type(v->type))
+    g_free(v->val.str);
+
+  g_strfreev(v->strv);
+  v->strv = NULL;
+  v->type = DBUS_TYPE_INVALID;
+}
+
+static gboolean
+ofono_write_strv_equal(const char *const *a, const char *const *b)
+{
+  if (!a || !b)
+    return a == b;
+
+  for (; *a && *b; a++, b++)
+  {
+    if (strcmp(*a, *b))
+      return FALSE;
+  }
+
+  return !*a && !*b;
+}
+
+static gboolean
+ofono_write_value_equal(const write_value *v, int type, const void *value)
+{
+  if (v->type != type)
+    return FALSE;
+
+  if (type == DBUS_TYPE_ARRAY)
+  {
+    return ofono_write_strv_equal((const char *const *)v->strv,
+                                  *(const char *const *const *)value);
+  }
+
+  if (ofono_write_is_string_type(type))
+    return !g_strcmp0(v->val.str, *(const char *const *)value);
+
+  if (type == DBUS_TYPE_BOOLEAN)
+    return !v->val.bool_val == !*(const dbus_bool_t *)value;
+
+  return !memcmp(&v->val, value, ofono_write_fixed_size(type));
+}
+
+static const void *
+ofono_write_value_get(const write_value *v)
+{
+  if (v->type == DBUS_TYPE_ARRAY)
+    return &v->strv;
+
+  return &v->val;
+}
+
+static GSList *
+ofono_write_waiter_add(GSList *waiters, const write_waiter *waiter)
+{
+  write_waiter *w = g_new(write_waiter, 1);
+
+  *w = *waiter;
+
+  return g_slist_prepend(waiters, w);
+}
+
+/* waiters were prepended, so complete them in reverse to keep call order */
+static void
+ofono_write_deliver(const write_waiter *w, const property_set_result *result)
+{
+  if (w->result_cb)
+    w->result_cb(result, w->user_data);
+  else if (w->cb)
+    w->cb(result->success, w->user_data);
+}
+
+static void
+ofono_write_completion_cb(gpointer data)
+{
+  write_completion *c = data;
+
+  c->result.error_name = c->error_name;
+  ofono_write_deliver(c->waiter, &c->result);
+
+  g_free(c->error_name);
+  g_free(c->waiter);
+  g_free(c);
+}
+
+/* with an engine thread the callbacks run on the notification context, the
+ * error name is copied as the reply is gone by then */
+static void
+ofono_write_complete(GSList *waiters, gboolean success,
+                     const char *error_name, gint64 rtt)
+{
+  gint64 now = g_get_monotonic_time();
+  GSList *l;
+
+  waiters = g_slist_reverse(waiters);
+
+  for (l = waiters; l; l = l->next)
+  {
+    write_waiter *w = l->data;
+    property_set_result result;
+
+    result.success = success;
+    result.error_name = error_name;
+    result.rtt = rtt;
+    result.elapsed = now - w->requested;
+
+    if (ofono_engine_is_threaded())
+    {
+      write_completion *c = g_new(write_completion, 1);
+
+      c->waiter = w;
+      c->result = result;
+      c->error_name = g_strdup(error_name);
+      ofono_engine_post(ofono_write_completion_cb, c);
+      l->data = NULL;
+    }
+    else
+      ofono_write_deliver(w, &result);
+  }
+
+  g_slist_free_full(waiters, g_free);
+}
+
+static void
+ofono_write_queue_free(gpointer data)
+{
+  write_queue *q = data;
+
+  ofono_write_value_clear(&q->current);
+  ofono_write_value_clear(&q->next);
+  g_free(q->key);
+  g_free(q);
+}
+
+static void
+ofono_write_queue_remove(write_queue *q)
+{
+  g_hash_table_remove(queues, q->key);
+
+  if (!g_hash_table_size(queues))
+  {
+    g_hash_table_unref(queues);
+    queues = NULL;
+  }
+}
+
+static void ofono_write_reply_cb(DBusMessage *reply, gpointer user_data);
+
+static gboolean
+ofono_write_send(write_queue *q)
+{
+  DBusMessage *message;
+  gboolean rv = FALSE;
+
+  OFONO_ENTER
+
+  message = ofono_iface_new_set_property(q->path, q->iface);
+
+  if (message)
+  {
+    DBusMessageIter iter;
+
+    dbus_message_iter_init_append(message, &iter);
+
+    if (dbus_helper_append_property(&iter, q->property, q->current.type,
+                                    ofono_write_value_get(&q->current)))
+    {
+      if (ofono_iface_call(q->iface, message, ofono_write_reply_cb, q))
+      {
+        q->sent = g_get_monotonic_time();
+        rv = TRUE;
+      }
+      else
+        OFONO_ERR("could not send 'SetProperty' method call");
+    }
+    else
+      OFONO_ERR("could not append 'SetProperty' data");
+
+    dbus_message_unref(message);
+  }
+  else
+    OFONO_ERR("could not create 'SetProperty' method call");
+
+  OFONO_EXIT
+
+  return rv;
+}
+
+static void
+ofono_write_reply_cb(DBusMessage *reply, gpointer user_data)
+{
+  write_queue *q = user_data;
+  GSList *done = q->current_waiters;
+  GSList *failed = NULL;
+  const char *failed_error = OFONO_PROPERTY_SET_ERROR_CANCELLED;
+  const char *error_name = NULL;
+  gint64 rtt = 0;
+
+  OFONO_ENTER
+
+  if (!reply)
+  {
+    OFONO_DEBUG("SetProperty %s cancelled", q->property);
+    error_name = OFONO_PROPERTY_SET_ERROR_CANCELLED;
+  }
+  else
+  {
+    rtt = g_get_monotonic_time() - q->sent;
+
+    if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+    {
+      error_name = dbus_message_get_error_name(reply);
+      OFONO_WARN("SetProperty %s returned '%s'", q->property, error_name);
+    }
+  }
+
+  q->current_waiters = NULL;
+  ofono_write_value_clear(&q->current);
+
+  /* a cancelled call means the object is gone, so is the queued value */
+  if (q->has_next && reply)
+  {
+    q->current = q->next;
+    q->current_waiters = q->next_waiters;
+    q->has_next = FALSE;
+    q->next.type = DBUS_TYPE_INVALID;
+    q->next_waiters = NULL;
+
+    if (!ofono_write_send(q))
+    {
+      failed_error = DBUS_ERROR_DISCONNECTED;
+      failed = q->current_waiters;
+      q->current_waiters = NULL;
+      ofono_write_queue_remove(q);
+    }
+  }
+  else
+  {
+    failed = q->next_waiters;
+    q->next_waiters = NULL;
+    ofono_write_queue_remove(q);
+  }
+
+  /* the queue is consistent now, callbacks may write again. error_name
+   * points into the reply, which stays valid until this returns. */
+  ofono_write_complete(done, !error_name, error_name, rtt);
+  ofono_write_complete(failed, FALSE, failed_error, 0);
+
+  OFONO_EXIT
+}
+
+static gboolean
+ofono_write_request(const char *path, ofono_iface_type iface,
+                    const char *property, int type, const void *value,
+                    const write_waiter *waiter)
+{
+  write_queue *q = NULL;
+  gchar *key;
+
+  if (!ofono_write_type_supported(type))
+  {
+    OFONO_ERR("unsupported type '%c' of property %s", type, property);
+    return FALSE;
+  }
+
+  key = g_strdup_printf("%s %s.%s", path, ofono_iface_name(iface), property);
+
+  if (queues)
+    q = g_hash_table_lookup(queues, key);
+
+  if (q)
+  {
+    g_free(key);
+
+    if (ofono_write_value_equal(&q->current, type, value))
+    {
+      /* the call in flight already writes the latest value */
+      if (q->has_next)
+      {
+        ofono_write_value_clear(&q->next);
+        q->has_next = FALSE;
+        q->current_waiters = g_slist_concat(q->next_waiters,
+                                            q->current_waiters);
+        q->next_waiters = NULL;
+      }
+
+      q->current_waiters = ofono_write_waiter_add(q->current_waiters, waiter);
+    }
+    else
+    {
+      ofono_write_value_clear(&q->next);
+      ofono_write_value_set(&q->next, type, value);
+      q->has_next = TRUE;
+      q->next_waiters = ofono_write_waiter_add(q->next_waiters, waiter);
+    }
+
+    return TRUE;
+  }
+
+  q = g_new0(write_queue, 1);
+  q->key = key;
+  ofono_write_value_set(&q->current, type, value);
+  q->path = string_pool_intern(path);
+  q->iface = iface;
+  q->property = string_pool_intern(property);
+
+  if (!queues)
+  {
+    queues = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                   ofono_write_queue_free);
+  }
+
+  g_hash_table_insert(queues, q->key, q);
+
+  if (!ofono_write_send(q))
+  {
+    ofono_write_queue_remove(q);
+    return FALSE;
+  }
+
+  q->current_waiters = ofono_write_waiter_add(NULL, waiter);
+
+  return TRUE;
+}
+
+static void
+ofono_write_request_cb(gpointer data)
+{
+  write_call *call = data;
+
+  call->rv = ofono_write_request(call->path, call->iface, call->property,
+                                 call->type, call->value, call->waiter);
+}
+
+/* the queues belong to the engine, the caller waits so the value can stay
+ * where it is until it is copied */
+static gboolean
+ofono_write_submit(const char *path, ofono_iface_type iface,
+                   const char *property, int type, const void *value,
+                   const write_waiter *waiter)
+{
+  write_call call = {path, iface, property, type, value, waiter, FALSE};
+
+  ofono_engine_call(ofono_write_request_cb, &call);
+
+  return call.rv;
+}
+
+/**
+ * @brief Sets an oFono property. Writes of the same property are serialized:
+ * while a SetProperty call is in flight, a request for the same value joins
+ * it and a request for another value replaces any value queued before it, so
+ * only the last one is sent. All merged callers are completed from the reply
+ * of the call that carried their value, or of the one that superseded it.
+ *
+ * @param path Object path
+ * @param iface Interface of the property
+ * @param property Property name
+ * @param type D-Bus type of the value, any basic type but DBUS_TYPE_UNIX_FD,
+ * or DBUS_TYPE_ARRAY for an array of strings
+ * @param value Pointer to the value, as for dbus_message_iter_append_basic(),
+ * for DBUS_TYPE_ARRAY a pointer to a NULL terminated string vector
+ * @param cb Called exactly once with the result of the write, can be NULL
+ * @param user_data User data passed to @a cb
+ *
+ * @return TRUE if the write was sent or queued, @a cb is not called otherwise
+ */
+gboolean
+ofono_write_property_full(const char *path, ofono_iface_type iface,
+                          const char *property, int type, const void *value,
+                          ofono_property_set_result_fn cb, gpointer user_data)
+{
+  write_waiter waiter = {NULL, cb, user_data, g_get_monotonic_time()};
+
+  return ofono_write_submit(path, iface, property, type, value, &waiter);
+}
+
+/**
+ * @brief Same as #ofono_write_property_full, with a callback that only gets
+ * whether the write succeeded
+ */
+gboolean
+ofono_write_property(const char *path, ofono_iface_type iface,
+                     const char *property, int type, const void *value,
+                     ofono_property_set_fn cb, gpointer user_data)
+{
+  write_waiter waiter = {cb, NULL, user_data, g_get_monotonic_time()};
+
+  return ofono_write_submit(path, iface, property, type, value, &waiter);
+}
@@ -0,0 +1,10 @@
+#ifndef __ICD_OFONO_WRITE_H__
+#define __ICD_OFONO_WRITE_H__
+
+#include "ofono-iface.h"
+#include "ofono-manager.h"
+
+gboolean ofono_write_property(const char *path, ofono_iface_type iface, const char *property, int type, const void *value, ofono_property_set_fn cb, gpointer user_data);
+gboolean ofono_write_property_full(const char *path, ofono_iface_type iface, const char *property, int type, const void *value, ofono_property_set_result_fn cb, gpointer user_data);
+
+#endif /* __ICD_OFONO_WRITE_H__ */
@@ -0,0 +1,647 @@
+#include <glib.h>
+
+#include "log.h"
+#include "property.h"
+
+struct _net_status_desc
+{
+  /** status name, must be the first member */
+  const char *name;
+  modem_net_status status;
+  gint registered;
+  gint roaming;
+};
+
+typedef struct _net_status_desc net_status_desc;
+
+struct _net_technology_desc
+{
+  /** technology name, must be the first member */
+  const char *name;
+  modem_net_technology technology;
+};
+
+typedef struct _net_technology_desc net_technology_desc;
+
+#define PROPERTY(_name, _dbus_type, _type, _field, _changed) \
+  {_name, _dbus_type, _type, G_STRUCT_OFFSET(modem, _field), \
+   OFONO_MODEM_CHANGED_##_changed}
+
+static const property_desc modem_properties[] =
+{
+  PROPERTY("Powered", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN, powered,
+           POWERED),
+  PROPERTY("Online", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN, online,
+           ONLINE),
+  PROPERTY("Emergency", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN,
+           emergency_call, EMERGENCY),
+  PROPERTY("Serial", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, imei, IMEI),
+  PROPERTY("Interfaces", DBUS_TYPE_ARRAY, PROPERTY_TYPE_MASK, interfaces,
+           INTERFACES),
+  {NULL}
+};
+
+static const property_desc sim_properties[] =
+{
+  PROPERTY("Present", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN, sim.present,
+           SIM_PRESENT),
+  PROPERTY("SubscriberIdentity", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+           sim.imsi, SIM_IMSI),
+  PROPERTY("ServiceProviderName", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+           sim.spn, SIM_SPN),
+  {NULL}
+};
+
+static const property_desc net_properties[] =
+{
+  PROPERTY("Status", DBUS_TYPE_STRING, PROPERTY_TYPE_NET_STATUS,
+           net.status, NET_STATUS),
+  PROPERTY("Name", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, net.name,
+           NET_NAME),
+  PROPERTY("Technology", DBUS_TYPE_STRING, PROPERTY_TYPE_NET_TECHNOLOGY,
+           net.technology, NET_TECHNOLOGY),
+  PROPERTY("Strength", DBUS_TYPE_BYTE, PROPERTY_TYPE_BYTE, net.strength,
+           NET_STRENGTH),
+  PROPERTY("LocationAreaCode", DBUS_TYPE_UINT16, PROPERTY_TYPE_UINT16,
+           net.lac, NET_LAC),
+  PROPERTY("CellId", DBUS_TYPE_UINT32, PROPERTY_TYPE_UINT32, net.cell_id,
+           NET_CELL_ID),
+  PROPERTY("MobileCountryCode", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+           net.mcc, NET_MCC),
+  PROPERTY("MobileNetworkCode", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+           net.mnc, NET_MNC),
+  {NULL}
+};
+
+static const property_desc conn_properties[] =
+{
+  PROPERTY("Attached", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN,
+           conn.attached, CONN_ATTACHED),
+  PROPERTY("Bearer", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, conn.bearer,
+           CONN_BEARER),
+  PROPERTY("Powered", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN, conn.powered,
+           CONN_POWERED),
+  PROPERTY("RoamingAllowed", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN,
+           conn.roaming_allowed, CONN_ROAMING_ALLOWED),
+  PROPERTY("Suspended", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN,
+           conn.suspended, CONN_SUSPENDED),
+  {NULL}
+};
+
+/* the password is not kept in memory */
+static const property_desc lte_properties[] =
+{
+  PROPERTY("DefaultAccessPointName", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+           lte.apn, LTE_APN),
+  PROPERTY("Protocol", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, lte.protocol,
+           LTE_PROTOCOL),
+  PROPERTY("AuthenticationMethod", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+           lte.auth_method, LTE_AUTH_METHOD),
+  PROPERTY("Username", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, lte.username,
+           LTE_USERNAME),
+  {NULL}
+};
+
+#define CONTEXT_PROPERTY(_name, _dbus_type, _type, _field, _changed) \
+  {_name, _dbus_type, _type, G_STRUCT_OFFSET(modem_context, _field), \
+   OFONO_MODEM_CHANGED_##_changed}
+
+/* strings of a context are not pooled, they are set by the user */
+static const property_desc context_properties[] =
+{
+  CONTEXT_PROPERTY("Active", DBUS_TYPE_BOOLEAN, PROPERTY_TYPE_BOOLEAN, active,
+                   CONTEXT_ACTIVE),
+  CONTEXT_PROPERTY("AccessPointName", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+                   apn, CONTEXT_APN),
+  CONTEXT_PROPERTY("Type", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, type,
+                   CONTEXT_TYPE),
+  CONTEXT_PROPERTY("Protocol", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING,
+                   protocol, CONTEXT_PROTOCOL),
+  CONTEXT_PROPERTY("Name", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, name,
+                   CONTEXT_NAME),
+  CONTEXT_PROPERTY("Settings", DBUS_TYPE_ARRAY, PROPERTY_TYPE_SETTINGS, ipv4,
+                   CONTEXT_SETTINGS),
+  CONTEXT_PROPERTY("IPv6.Settings", DBUS_TYPE_ARRAY, PROPERTY_TYPE_SETTINGS,
+                   ipv6, CONTEXT_IPV6_SETTINGS),
+  {NULL}
+};
+
+#define SETTING(_name, _dbus_type, _type, _field) \
+  {_name, _dbus_type, _type, G_STRUCT_OFFSET(modem_context_settings, _field), \
+   0}
+
+/* entries of the "Settings" and "IPv6.Settings" dictionaries */
+static const property_desc context_settings[] =
+{
+  SETTING("Interface", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, interface),
+  SETTING("Method", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, method),
+  SETTING("Address", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, address),
+  SETTING("Netmask", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, netmask),
+  SETTING("PrefixLength", DBUS_TYPE_BYTE, PROPERTY_TYPE_UINT8, prefix_length),
+  SETTING("Gateway", DBUS_TYPE_STRING, PROPERTY_TYPE_STRING, gateway),
+  SETTING("DomainNameServers", DBUS_TYPE_ARRAY, PROPERTY_TYPE_STRV, dns),
+  {NULL}
+};
+
+static const property_desc *const iface_properties[OFONO_IFACE_LAST] =
+{
+  [OFONO_IFACE_MODEM] = modem_properties,
+  [OFONO_IFACE_SIM] = sim_properties,
+  [OFONO_IFACE_NET] = net_properties,
+  [OFONO_IFACE_CONN] = conn_properties,
+  [OFONO_IFACE_CONTEXT] = context_properties,
+  [OFONO_IFACE_LTE] = lte_properties
+};
+
+static const net_status_desc net_statuses[] =
+{
+  {"unregistered", MODEM_NET_STATUS_UNREGISTERED, FALSE, FALSE},
+  {"registered", MODEM_NET_STATUS_REGISTERED, TRUE, FALSE},
+  {"searching", MODEM_NET_STATUS_SEARCHING, FALSE, FALSE},
+  {"denied", MODEM_NET_STATUS_DENIED, FALSE, FALSE},
+  {"unknown", MODEM_NET_STATUS_UNKNOWN, FALSE, FALSE},
+  {"roaming", MODEM_NET_STATUS_ROAMING, TRUE, TRUE},
+  {NULL}
+};
+
+static const net_technology_desc net_technologies[] =
+{
+  {"gsm", MODEM_NET_TECHNOLOGY_GSM},
+  {"edge", MODEM_NET_TECHNOLOGY_EDGE},
+  {"umts", MODEM_NET_TECHNOLOGY_UMTS},
+  {"hspa", MODEM_NET_TECHNOLOGY_HSPA},
+  {"lte", MODEM_NET_TECHNOLOGY_LTE},
+  {"nr", MODEM_NET_TECHNOLOGY_NR},
+  {NULL}
+};
+
+/* name -> descriptor indexes, all built at once on first use, lookups may
+ * come from the caller thread as well as from the engine */
+static GOnce index_once = G_ONCE_INIT;
+static GHashTable *property_index[OFONO_IFACE_LAST];
+static GHashTable *net_status_index = NULL;
+static GHashTable *net_technology_index = NULL;
+static GHashTable *setting_index = NULL;
+
+/* every table entry starts with its name and the table is NULL terminated */
+static GHashTable *
+property_index_new(gconstpointer table, gsize entry_size)
+{
+  GHashTable *index = g_hash_table_new(g_str_hash, g_str_equal);
+  const guint8 *entry;
+
+  for (entry = table; *(const char *const *)entry; entry += entry_size)
+    g_hash_table_insert(index, *(gpointer *)entry, (gpointer)entry);
+
+  return index;
+}
+
+static gpointer
+property_index_init(gpointer data)
+{
+  int i;
+
+  for (i = 0; i < OFONO_IFACE_LAST; i++)
+  {
+    if (iface_properties[i])
+    {
+      property_index[i] = property_index_new(iface_properties[i],
+                                             sizeof(property_desc));
+    }
+  }
+
+  net_status_index = property_index_new(net_statuses,
+                                        sizeof(net_status_desc));
+  net_technology_index = property_index_new(net_technologies,
+                                            sizeof(net_technology_desc));
+  setting_index = property_index_new(context_settings, sizeof(property_desc));
+
+  return data;
+}
+
+/**
+ * @brief Finds the descriptor of an oFono property
+ *
+ * @param iface Interface the property belongs to
+ * @param name Property name
+ *
+ * @return The descriptor or NULL if the property is not tracked
+ */
+const property_desc *
+property_lookup(ofono_iface_type iface, const char *name)
+{
+  g_return_val_if_fail(iface < OFONO_IFACE_LAST, NULL);
+
+  if (!iface_properties[iface])
+    return NULL;
+
+  g_once(&index_once, property_index_init, NULL);
+
+  return g_hash_table_lookup(property_index[iface], name);
+}
+
+/**
+ * @brief Finds the descriptor of an entry of a ConnectionContext settings
+ * dictionary
+ *
+ * @param name Entry name
+ *
+ * @return The descriptor or NULL if the entry is not tracked
+ */
+const property_desc *
+property_lookup_setting(const char *name)
+{
+  g_once(&index_once, property_index_init, NULL);
+
+  return g_hash_table_lookup(setting_index, name);
+}
+
+static guint64
+property_apply_net_status(modem *m, const char *status, gboolean write)
+{
+  const net_status_desc *desc;
+  modem_net_status net_status = MODEM_NET_STATUS_UNKNOWN;
+  gint registered = FALSE;
+  gint roaming = FALSE;
+  guint64 changed = 0;
+
+  /* reached through property_lookup(), the indexes are built */
+  desc = g_hash_table_lookup(net_status_index, status);
+
+  if (desc)
+  {
+    net_status = desc->status;
+    registered = desc->registered;
+    roaming = desc->roaming;
+  }
+
+  if (m->net.status != net_status)
+  {
+    if (write)
+      m->net.status = net_status;
+
+    changed |= OFONO_MODEM_CHANGED_NET_STATUS;
+  }
+
+  if (m->net.registered != registered)
+  {
+    if (write)
+      m->net.registered = registered;
+
+    changed |= OFONO_MODEM_CHANGED_NET_REGISTERED;
+  }
+
+  if (m->net.roaming != roaming)
+  {
+    if (write)
+      m->net.roaming = roaming;
+
+    changed |= OFONO_MODEM_CHANGED_NET_ROAMING;
+  }
+
+  return changed;
+}
+
+static guint64
+property_apply_net_technology(modem *m, const char *technology,
+                              gboolean write)
+{
+  const net_technology_desc *desc;
+  modem_net_technology net_technology = MODEM_NET_TECHNOLOGY_NONE;
+
+  desc = g_hash_table_lookup(net_technology_index, technology);
+
+  if (desc)
+    net_technology = desc->technology;
+
+  if (m->net.technology == net_technology)
+    return 0;
+
+  if (write)
+    m->net.technology = net_technology;
+
+  return OFONO_MODEM_CHANGED_NET_TECHNOLOGY;
+}
+
+/* record is a #modem_context for OFONO_IFACE_CONTEXT, a #modem otherwise */
+static guint64
+property_apply(ofono_iface_type iface, gpointer record,
+               const property_changed *pc, gboolean write)
+{
+  const property_desc *desc = property_lookup(iface, pc->property);
+
+  if (!desc)
+    return 0;
+
+  if (desc->dbus_type != pc->type)
+  {
+    OFONO_WARN("Unexpected type '%c' of property %s", pc->type, desc->name);
+    return 0;
+  }
+
+  switch (desc->type)
+  {
+    case PROPERTY_TYPE_BOOLEAN:
+    {
+      gint *b = G_STRUCT_MEMBER_P(record, desc->offset);
+
+      if (*b == (gint)pc->val.bool_val)
+        return 0;
+
+      if (write)
+        *b = pc->val.bool_val;
+
+      break;
+    }
+    case PROPERTY_TYPE_STRING:
+    {
+      gchar **s = G_STRUCT_MEMBER_P(record, desc->offset);
+
+      if (!g_strcmp0(*s, pc->val.str))
+        return 0;
+
+      if (!write)
+        return desc->changed;
+
+      if (iface == OFONO_IFACE_CONTEXT)
+      {
+        g_free(*s);
+        *s = g_strdup(pc->val.str);
+      }
+      else
+        modem_set_string(record, s, pc->val.str);
+
+      break;
+    }
+    case PROPERTY_TYPE_MASK:
+    {
+      guint64 *mask = G_STRUCT_MEMBER_P(record, desc->offset);
+
+      if (*mask == pc->val.u64)
+        return 0;
+
+      if (write)
+        *mask = pc->val.u64;
+
+      break;
+    }
+    case PROPERTY_TYPE_BYTE:
+    {
+      gint8 *byte = G_STRUCT_MEMBER_P(record, desc->offset);
+
+      if (*byte == (gint8)pc->val.byt)
+        return 0;
+
+      if (write)
+        *byte = pc->val.byt;
+
+      break;
+    }
+    case PROPERTY_TYPE_UINT16:
+    {
+      guint16 *u16 = G_STRUCT_MEMBER_P(record, desc->offset);
+
+      if (*u16 == pc->val.u16)
+        return 0;
+
+      if (write)
+        *u16 = pc->val.u16;
+
+      break;
+    }
+    case PROPERTY_TYPE_UINT32:
+    {
+      guint32 *u32 = G_STRUCT_MEMBER_P(record, desc->offset);
+
+      if (*u32 == pc->val.u32)
+        return 0;
+
+      if (write)
+        *u32 = pc->val.u32;
+
+      break;
+    }
+    case PROPERTY_TYPE_UINT8:
+    {
+      guchar *u8 = G_STRUCT_MEMBER_P(record, desc->offset);
+
+      if (*u8 == pc->val.byt)
+        return 0;
+
+      if (write)
+        *u8 = pc->val.byt;
+
+      break;
+    }
+    case PROPERTY_TYPE_NET_STATUS:
+      return property_apply_net_status(record, pc->val.str, write);
+    case PROPERTY_TYPE_NET_TECHNOLOGY:
+      return property_apply_net_technology(record, pc->val.str, write);
+    case PROPERTY_TYPE_STRV:
+    case PROPERTY_TYPE_SETTINGS:
+      /* containers are decoded by the interface, never passed here */
+      return 0;
+  }
+
+  return desc->changed;
+}
+
+/**
+ * @brief Tells which fields of the modem record a changed property would
+ * modify, without modifying it
+ *
+ * @param iface Interface the property belongs to
+ * @param m Modem
+ * @param pc Changed property
+ *
+ * @return OFONO_MODEM_CHANGED_* mask of the fields that would get a new value
+ */
+guint64
+property_check(ofono_iface_type iface, const modem *m,
+               const property_changed *pc)
+{
+  return property_apply(iface, (modem *)m, pc, FALSE);
+}
+
+/**
+ * @brief Stores a changed property value in the modem record
+ *
+ * @param iface Interface the property belongs to
+ * @param m Modem to update
+ * @param pc Changed property
+ *
+ * @return OFONO_MODEM_CHANGED_* mask of the fields that got a new value, 0 if
+ * the property is not tracked or its value is the same as before
+ */
+guint64
+property_update(ofono_iface_type iface, modem *m, const property_changed *pc)
+{
+  return property_apply(iface, m, pc, TRUE);
+}
+
+/**
+ * @brief Stores a changed basic property value in a context record
+ *
+ * @param c Context to update
+ * @param pc Changed property
+ *
+ * @return OFONO_MODEM_CHANGED_CONTEXT_* bit of the field that got a new
+ * value, 0 if the property is not tracked or its value is the same as before
+ */
+guint64
+property_update_context(modem_context *c, const property_changed *pc)
+{
+  return property_apply(OFONO_IFACE_CONTEXT, c, pc, TRUE);
+}
+
+/* sets a gint sized field to value, returns whether it changed */
+static gboolean
+property_reset_int(gint *field, gint value)
+{
+  if (*field == value)
+    return FALSE;
+
+  *field = value;
+
+  return TRUE;
+}
+
+/**
+ * @brief Sets every field of an interface back to unknown, e.g. once the
+ * interface is no longer watched
+ *
+ * @param iface Interface
+ * @param m Modem to update
+ *
+ * @return OFONO_MODEM_CHANGED_* mask of the fields that had a value
+ */
+guint64
+property_reset(ofono_iface_type iface, modem *m)
+{
+  const property_desc *desc;
+  guint64 changed = 0;
+
+  g_return_val_if_fail(iface < OFONO_IFACE_LAST, 0);
+
+  for (desc = iface_properties[iface]; desc && desc->name; desc++)
+  {
+    gpointer field = G_STRUCT_MEMBER_P(m, desc->offset);
+    gboolean reset = FALSE;
+
+    switch (desc->type)
+    {
+      case PROPERTY_TYPE_BOOLEAN:
+        reset = property_reset_int(field, -1);
+        break;
+      case PROPERTY_TYPE_STRING:
+        if ((reset = *(gchar **)field != NULL))
+          modem_set_string(m, field, NULL);
+
+        break;
+      case PROPERTY_TYPE_MASK:
+        if ((reset = *(guint64 *)field != 0))
+          *(guint64 *)field = 0;
+
+        break;
+      case PROPERTY_TYPE_BYTE:
+        if ((reset = *(gint8 *)field != -1))
+          *(gint8 *)field = -1;
+
+        break;
+      case PROPERTY_TYPE_UINT16:
+        if ((reset = *(guint16 *)field != 0))
+          *(guint16 *)field = 0;
+
+        break;
+      case PROPERTY_TYPE_UINT32:
+        if ((reset = *(guint32 *)field != 0))
+          *(guint32 *)field = 0;
+
+        break;
+      case PROPERTY_TYPE_NET_STATUS:
+        reset = property_reset_int(field, MODEM_NET_STATUS_NONE);
+
+        if (property_reset_int(&m->net.registered, -1))
+          changed |= OFONO_MODEM_CHANGED_NET_REGISTERED;
+
+        if (property_reset_int(&m->net.roaming, -1))
+          changed |= OFONO_MODEM_CHANGED_NET_ROAMING;
+
+        break;
+      case PROPERTY_TYPE_NET_TECHNOLOGY:
+        reset = property_reset_int(field, MODEM_NET_TECHNOLOGY_NONE);
+        break;
+      default:
+        /* not used by the modem interfaces */
+        break;
+    }
+
+    if (reset)
+      changed |= desc->changed;
+  }
+
+  return changed;
+}
+
+/**
+ * @brief Tells which fields of the modem record an interface sets
+ *
+ * @param iface Interface
+ *
+ * @return OFONO_MODEM_CHANGED_* mask of the fields
+ */
+guint64
+property_changed_mask(ofono_iface_type iface)
+{
+  const property_desc *desc;
+  guint64 changed = 0;
+
+  g_return_val_if_fail(iface < OFONO_IFACE_LAST, 0);
+
+  for (desc = iface_properties[iface]; desc && desc->name; desc++)
+  {
+    changed |= desc->changed;
+
+    if (desc->type == PROPERTY_TYPE_NET_STATUS)
+    {
+      changed |= OFONO_MODEM_CHANGED_NET_REGISTERED |
+          OFONO_MODEM_CHANGED_NET_ROAMING;
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * @brief Reads the value of a numeric property from the modem record
+ *
+ * @param desc Property descriptor
+ * @param m Modem
+ * @param value Return location for the value
+ *
+ * @return FALSE if the property is not a number or its value is unknown
+ */
+gboolean
+property_get_number(const property_desc *desc, const modem *m, gint64 *value)
+{
+  gconstpointer field = G_STRUCT_MEMBER_P(m, desc->offset);
+
+  /* booleans and the strength are -1 until reported */
+  switch (desc->type)
+  {
+    case PROPERTY_TYPE_BOOLEAN:
+      *value = *(const gint *)field;
+      return *value != -1;
+    case PROPERTY_TYPE_BYTE:
+      *value = *(const gint8 *)field;
+      return *value != -1;
+    case PROPERTY_TYPE_UINT16:
+      *value = *(const guint16 *)field;
+      return TRUE;
+    case PROPERTY_TYPE_UINT32:
+      *value = *(const guint32 *)field;
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
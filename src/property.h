@@ -0,0 +1,65 @@
+#ifndef __ICD_OFONO_PROPERTY_H__
+#define __ICD_OFONO_PROPERTY_H__
+
+#include "modem.h"
+#include "ofono-manager.h"
+#include "ofono-iface.h"
+
+/** @brief How a property value is converted and stored in #modem,
+ * #modem_context or #modem_context_settings */
+enum property_type
+{
+  /** DBUS_TYPE_BOOLEAN stored as gint */
+  PROPERTY_TYPE_BOOLEAN,
+  /** DBUS_TYPE_STRING stored as newly allocated gchar * */
+  PROPERTY_TYPE_STRING,
+  /** already decoded bitmask stored as guint64 */
+  PROPERTY_TYPE_MASK,
+  /** DBUS_TYPE_BYTE stored as gint8 */
+  PROPERTY_TYPE_BYTE,
+  /** DBUS_TYPE_UINT16 stored as guint16 */
+  PROPERTY_TYPE_UINT16,
+  /** DBUS_TYPE_UINT32 stored as guint32 */
+  PROPERTY_TYPE_UINT32,
+  /** NetworkRegistration "Status" string */
+  PROPERTY_TYPE_NET_STATUS,
+  /** NetworkRegistration "Technology" string */
+  PROPERTY_TYPE_NET_TECHNOLOGY,
+  /** DBUS_TYPE_BYTE stored as guchar */
+  PROPERTY_TYPE_UINT8,
+  /** array of DBUS_TYPE_STRING stored as newly allocated gchar ** */
+  PROPERTY_TYPE_STRV,
+  /** ConnectionContext settings dictionary stored as
+   * #modem_context_settings */
+  PROPERTY_TYPE_SETTINGS
+};
+
+typedef enum property_type property_type;
+
+/** @brief Describes where and how a single oFono property is stored */
+struct _property_desc
+{
+  /** property name, must be the first member */
+  const char *name;
+  /** expected D-Bus type of the value */
+  int dbus_type;
+  property_type type;
+  /** offset of the field in the record */
+  glong offset;
+  /** OFONO_MODEM_CHANGED_* bit of the field, 0 for settings entries */
+  guint64 changed;
+};
+
+typedef struct _property_desc property_desc;
+
+const property_desc *property_lookup(ofono_iface_type iface, const char *name);
+guint64 property_check(ofono_iface_type iface, const modem *m, const property_changed *pc);
+guint64 property_update(ofono_iface_type iface, modem *m, const property_changed *pc);
+guint64 property_reset(ofono_iface_type iface, modem *m);
+guint64 property_changed_mask(ofono_iface_type iface);
+gboolean property_get_number(const property_desc *desc, const modem *m, gint64 *value);
+
+guint64 property_update_context(modem_context *c, const property_changed *pc);
+const property_desc *property_lookup_setting(const char *name);
+
+#endif /* __ICD_OFONO_PROPERTY_H__ */
@@ -0,0 +1,36 @@
+#include "string-pool.h"
+
+/* The pool is the GLib quark table: process-wide, thread-safe, and the
+ * strings in it are never freed, so interned strings can be compared and
+ * hashed by pointer and kept without copying. It is meant for object paths
+ * and values that repeat, not for arbitrary data. */
+
+/**
+ * @brief Gets the pooled copy of a string, adding it to the pool if needed
+ *
+ * @param s String or NULL
+ *
+ * @return The pooled string, valid for the lifetime of the process, NULL if
+ * @a s is NULL
+ */
+const gchar *
+string_pool_intern(const char *s)
+{
+  return g_intern_string(s);
+}
+
+/**
+ * @brief Gets the pooled copy of a string without adding it, for lookups in
+ * tables keyed by pooled strings
+ *
+ * @param s String or NULL
+ *
+ * @return The pooled string or NULL if @a s was never interned
+ */
+const gchar *
+string_pool_lookup(const char *s)
+{
+  GQuark q = g_quark_try_string(s);
+
+  return q ? g_quark_to_string(q) : NULL;
+}
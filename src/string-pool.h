@@ -0,0 +1,9 @@
+#ifndef __ICD_OFONO_STRING_POOL_H__
+#define __ICD_OFONO_STRING_POOL_H__
+
+#include <glib.h>
+
+const gchar *string_pool_intern(const char *s);
+const gchar *string_pool_lookup(const char *s);
+
+#endif /* __ICD_OFONO_STRING_POOL_H__ */
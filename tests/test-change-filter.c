@@ -0,0 +1,322 @@
+#include <glib.h>
+
+#include "change-filter.h"
+#include "string-pool.h"
+
+#define MODEM_PATH "/test_0"
+
+/* intervals are short, the tests wait for them on the default main context */
+#define INTERVAL 100
+
+static change_filter *filter = NULL;
+static GHashTable *modems = NULL;
+static const gchar *path = NULL;
+static guint64 delivered = 0;
+static gint8 delivered_strength = 0;
+static guint deliveries = 0;
+
+static void
+deliver_cb(const modem *m, guint64 changed, gpointer user_data)
+{
+  delivered |= changed;
+  delivered_strength = m->net.strength;
+  deliveries++;
+}
+
+static const modem *
+lookup_cb(const gchar *path, gpointer user_data)
+{
+  const modem *m = modem_list_find(modems, path);
+
+  return m ? modem_ref(m) : NULL;
+}
+
+static GMainContext *
+get_context(void)
+{
+  return NULL;
+}
+
+static void
+set_policy(const char *property, guint interval, guint deadband,
+           gboolean latest)
+{
+  change_policy policy = {interval, deadband, latest};
+
+  change_filter_set_policy(filter, property_lookup(OFONO_IFACE_NET, property),
+                           &policy);
+}
+
+/* changes the strength of the modem and returns the changes to notify now */
+static guint64
+set_strength(gint8 strength)
+{
+  modem *m = modem_list_modify(modems, path);
+
+  m->net.strength = strength;
+
+  return change_filter_apply(filter, m, OFONO_MODEM_CHANGED_NET_STRENGTH);
+}
+
+static guint64
+set_name(const char *name)
+{
+  modem *m = modem_list_modify(modems, path);
+
+  modem_set_string(m, &m->net.name, name);
+
+  return change_filter_apply(filter, m, OFONO_MODEM_CHANGED_NET_NAME);
+}
+
+/* runs the default main context for ms milliseconds */
+static void
+run_pending(guint ms)
+{
+  gint64 end = g_get_monotonic_time() + ms * 1000;
+
+  while (g_get_monotonic_time() < end)
+  {
+    while (g_main_context_iteration(NULL, FALSE))
+      ;
+
+    g_usleep(5000);
+  }
+
+  while (g_main_context_iteration(NULL, FALSE))
+    ;
+}
+
+/* runs the default main context until the next delivery */
+static void
+wait_delivery(void)
+{
+  guint n = deliveries;
+
+  while (deliveries == n)
+    g_main_context_iteration(NULL, TRUE);
+}
+
+static void
+setup(void)
+{
+  modem *m;
+
+  filter = change_filter_new(get_context, lookup_cb, deliver_cb, NULL);
+  modems = modem_list_create();
+  m = modem_list_insert(modems, modem_new(MODEM_PATH, TRUE));
+  m->net.strength = 50;
+  path = m->path;
+  delivered = 0;
+  delivered_strength = 0;
+  deliveries = 0;
+}
+
+static void
+teardown(void)
+{
+  change_filter_free(filter);
+  filter = NULL;
+  modem_list_free(modems);
+  modems = NULL;
+
+  /* the timers of the filter are gone with it */
+  run_pending(0);
+}
+
+/* without a policy every change is notified */
+static void
+test_change_filter_no_policy(void)
+{
+  setup();
+
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(61), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+
+  set_policy("Strength", INTERVAL, 0, FALSE);
+  change_filter_set_policy(filter, property_lookup(OFONO_IFACE_NET,
+                                                   "Strength"), NULL);
+  g_assert_cmphex(set_strength(62), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(63), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+
+  teardown();
+}
+
+/* changes within the interval are dropped, other properties pass */
+static void
+test_change_filter_interval(void)
+{
+  setup();
+
+  set_policy("Strength", INTERVAL, 0, FALSE);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(70), ==, 0);
+  g_assert_cmphex(set_name("Operator"), ==, OFONO_MODEM_CHANGED_NET_NAME);
+
+  run_pending(INTERVAL * 2);
+  g_assert_cmpuint(deliveries, ==, 0);
+  g_assert_cmphex(set_strength(80), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+
+  teardown();
+}
+
+/* with "latest" the last change within the interval is delivered once it
+ * elapses */
+static void
+test_change_filter_latest(void)
+{
+  setup();
+
+  set_policy("Strength", INTERVAL, 0, TRUE);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(70), ==, 0);
+  g_assert_cmphex(set_strength(80), ==, 0);
+  g_assert_cmpuint(deliveries, ==, 0);
+
+  wait_delivery();
+  g_assert_cmpuint(deliveries, ==, 1);
+  g_assert_cmphex(delivered, ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmpint(delivered_strength, ==, 80);
+
+  /* the delivery starts a new interval */
+  g_assert_cmphex(set_strength(90), ==, 0);
+
+  teardown();
+}
+
+/* changes smaller than the deadband, compared to the value last notified,
+ * are dropped */
+static void
+test_change_filter_deadband(void)
+{
+  setup();
+
+  set_policy("Strength", 0, 10, FALSE);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(65), ==, 0);
+  g_assert_cmphex(set_strength(69), ==, 0);
+  g_assert_cmphex(set_strength(51), ==, 0);
+  g_assert_cmphex(set_strength(70), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(61), ==, 0);
+
+  teardown();
+}
+
+/* the values of a new modem are the reference of the deadband */
+static void
+test_change_filter_new_modem(void)
+{
+  modem *m;
+
+  setup();
+
+  set_policy("Strength", 0, 10, FALSE);
+  m = modem_list_modify(modems, path);
+  g_assert_cmphex(change_filter_apply(filter, m, OFONO_MODEM_CHANGED_ALL), ==,
+                  OFONO_MODEM_CHANGED_ALL);
+  g_assert_cmphex(set_strength(55), ==, 0);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+
+  teardown();
+}
+
+/* a forgotten modem has nothing held back and its next change passes */
+static void
+test_change_filter_forget(void)
+{
+  setup();
+
+  set_policy("Strength", INTERVAL, 0, TRUE);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(70), ==, 0);
+
+  change_filter_forget(filter, path);
+  run_pending(INTERVAL * 2);
+  g_assert_cmpuint(deliveries, ==, 0);
+
+  g_assert_cmphex(set_strength(80), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  change_filter_reset(filter);
+  g_assert_cmphex(set_strength(90), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+
+  teardown();
+}
+
+/* the filter keeps no reference, so records are still modified in place */
+static void
+test_change_filter_no_copy(void)
+{
+  const modem *m;
+
+  setup();
+
+  set_policy("Strength", INTERVAL, 0, TRUE);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  m = modem_list_find(modems, path);
+  g_assert_cmphex(set_strength(70), ==, 0);
+  g_assert_true(modem_list_find(modems, path) == m);
+
+  /* the held change is delivered with the record current by then */
+  g_assert_cmphex(set_strength(75), ==, 0);
+  wait_delivery();
+  g_assert_cmpint(delivered_strength, ==, 75);
+
+  teardown();
+}
+
+/* held changes of a modem removed meanwhile are dropped */
+static void
+test_change_filter_removed(void)
+{
+  setup();
+
+  set_policy("Strength", INTERVAL, 0, TRUE);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(70), ==, 0);
+
+  modem_list_remove(modems, path);
+  run_pending(INTERVAL * 2);
+  g_assert_cmpuint(deliveries, ==, 0);
+
+  teardown();
+}
+
+/* only the forgotten fields lose their state */
+static void
+test_change_filter_forget_fields(void)
+{
+  setup();
+
+  set_policy("Strength", INTERVAL, 0, TRUE);
+  set_policy("Name", INTERVAL, 0, TRUE);
+  g_assert_cmphex(set_strength(60), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_name("Operator"), ==, OFONO_MODEM_CHANGED_NET_NAME);
+  g_assert_cmphex(set_strength(70), ==, 0);
+  g_assert_cmphex(set_name("Other"), ==, 0);
+
+  change_filter_forget_fields(filter, path, OFONO_MODEM_CHANGED_NET_STRENGTH);
+  g_assert_cmphex(set_strength(80), ==, OFONO_MODEM_CHANGED_NET_STRENGTH);
+
+  run_pending(INTERVAL * 2);
+  g_assert_cmpuint(deliveries, ==, 1);
+  g_assert_cmphex(delivered, ==, OFONO_MODEM_CHANGED_NET_NAME);
+
+  teardown();
+}
+
+int
+main(int argc, char *argv[])
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/change-filter/no-policy", test_change_filter_no_policy);
+  g_test_add_func("/change-filter/interval", test_change_filter_interval);
+  g_test_add_func("/change-filter/latest", test_change_filter_latest);
+  g_test_add_func("/change-filter/deadband", test_change_filter_deadband);
+  g_test_add_func("/change-filter/new-modem", test_change_filter_new_modem);
+  g_test_add_func("/change-filter/forget", test_change_filter_forget);
+  g_test_add_func("/change-filter/no-copy", test_change_filter_no_copy);
+  g_test_add_func("/change-filter/removed", test_change_filter_removed);
+  g_test_add_func("/change-filter/forget-fields",
+                  test_change_filter_forget_fields);
+
+  return g_test_run();
+}
@@ -0,0 +1,219 @@
+#include <glib.h>
+
+#include "ofono-context.h"
+#include "ofono-iface.h"
+#include "ofono-manager.h"
+
+#define CONTEXT_PATH "/test_0/context1"
+
+/* ofono-context.c only forwards watches, they are not used here */
+gboolean
+ofono_iface_watch(const char *path, ofono_iface_type type, ofono_notify_fn cb,
+                  gpointer user_data)
+{
+  return FALSE;
+}
+
+void
+ofono_iface_close(const char *path, ofono_iface_type type, ofono_notify_fn cb,
+                  gpointer user_data)
+{
+}
+
+static void
+append_string(DBusMessageIter *dict, const char *key, const char *value)
+{
+  DBusMessageIter entry;
+  DBusMessageIter variant;
+
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+                                   DBUS_TYPE_STRING_AS_STRING, &variant);
+  dbus_message_iter_append_basic(&variant, DBUS_TYPE_STRING, &value);
+  dbus_message_iter_close_container(&entry, &variant);
+  dbus_message_iter_close_container(dict, &entry);
+}
+
+static void
+append_byte(DBusMessageIter *dict, const char *key, guchar value)
+{
+  DBusMessageIter entry;
+  DBusMessageIter variant;
+
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+                                   DBUS_TYPE_BYTE_AS_STRING, &variant);
+  dbus_message_iter_append_basic(&variant, DBUS_TYPE_BYTE, &value);
+  dbus_message_iter_close_container(&entry, &variant);
+  dbus_message_iter_close_container(dict, &entry);
+}
+
+static void
+append_strv(DBusMessageIter *dict, const char *key, const char **value)
+{
+  DBusMessageIter entry;
+  DBusMessageIter variant;
+  DBusMessageIter array;
+
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+                                   DBUS_TYPE_ARRAY_AS_STRING
+                                   DBUS_TYPE_STRING_AS_STRING, &variant);
+  dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY,
+                                   DBUS_TYPE_STRING_AS_STRING, &array);
+
+  for (; *value; value++)
+    dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, value);
+
+  dbus_message_iter_close_container(&variant, &array);
+  dbus_message_iter_close_container(&entry, &variant);
+  dbus_message_iter_close_container(dict, &entry);
+}
+
+/* PropertyChanged signal of a settings dictionary, filled by append */
+static DBusMessage *
+settings_changed(const char *property,
+                 void (*append)(DBusMessageIter *dict))
+{
+  DBusMessage *message = dbus_message_new_signal(CONTEXT_PATH,
+                                                 OFONO_CONNECTION_CONTEXT_INTERFACE,
+                                                 "PropertyChanged");
+  DBusMessageIter iter;
+  DBusMessageIter variant;
+  DBusMessageIter dict;
+
+  dbus_message_iter_init_append(message, &iter);
+  dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &property);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_VARIANT, "a{sv}",
+                                   &variant);
+  dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "{sv}", &dict);
+
+  if (append)
+    append(&dict);
+
+  dbus_message_iter_close_container(&variant, &dict);
+  dbus_message_iter_close_container(&iter, &variant);
+
+  return message;
+}
+
+static guint64
+read_property(DBusMessage *message, modem_context *c)
+{
+  DBusMessageIter iter;
+  guint64 changed;
+
+  g_assert_true(dbus_message_iter_init(message, &iter));
+  changed = ofono_context_read_property(&iter, c);
+  dbus_message_unref(message);
+
+  return changed;
+}
+
+static void
+append_ipv4(DBusMessageIter *dict)
+{
+  const char *dns[] = {"10.0.0.1", "10.0.0.2", NULL};
+
+  append_string(dict, "Interface", "rmnet0");
+  append_string(dict, "Method", "static");
+  append_string(dict, "Address", "10.1.2.3");
+  append_string(dict, "Netmask", "255.255.255.0");
+  append_string(dict, "Gateway", "10.1.2.1");
+  append_strv(dict, "DomainNameServers", dns);
+  /* not tracked */
+  append_string(dict, "Proxy", "10.0.0.3");
+}
+
+static void
+append_ipv6(DBusMessageIter *dict)
+{
+  append_string(dict, "Interface", "rmnet0");
+  append_string(dict, "Address", "2001:db8::1");
+  append_byte(dict, "PrefixLength", 64);
+}
+
+/* entries of the wrong type are skipped, the others are kept */
+static void
+append_bad_type(DBusMessageIter *dict)
+{
+  append_byte(dict, "Address", 1);
+  append_string(dict, "Interface", "rmnet1");
+}
+
+static void
+test_context_settings(void)
+{
+  modem_context *c = modem_context_new(CONTEXT_PATH);
+
+  g_assert_cmphex(read_property(settings_changed("Settings", append_ipv4), c),
+                  ==, OFONO_MODEM_CHANGED_CONTEXT_SETTINGS);
+  g_assert_cmpstr(c->ipv4.interface, ==, "rmnet0");
+  g_assert_cmpstr(c->ipv4.method, ==, "static");
+  g_assert_cmpstr(c->ipv4.address, ==, "10.1.2.3");
+  g_assert_cmpstr(c->ipv4.netmask, ==, "255.255.255.0");
+  g_assert_cmpstr(c->ipv4.gateway, ==, "10.1.2.1");
+  g_assert_nonnull(c->ipv4.dns);
+  g_assert_cmpstr(c->ipv4.dns[0], ==, "10.0.0.1");
+  g_assert_cmpstr(c->ipv4.dns[1], ==, "10.0.0.2");
+  g_assert_null(c->ipv4.dns[2]);
+  g_assert_null(c->ipv6.address);
+
+  /* the same dictionary again is no change */
+  g_assert_cmphex(read_property(settings_changed("Settings", append_ipv4), c),
+                  ==, 0);
+
+  /* an empty dictionary clears the settings */
+  g_assert_cmphex(read_property(settings_changed("Settings", NULL), c),
+                  ==, OFONO_MODEM_CHANGED_CONTEXT_SETTINGS);
+  g_assert_null(c->ipv4.interface);
+  g_assert_null(c->ipv4.dns);
+
+  modem_context_unref(c);
+}
+
+static void
+test_context_ipv6_settings(void)
+{
+  modem_context *c = modem_context_new(CONTEXT_PATH);
+
+  g_assert_cmphex(read_property(settings_changed("IPv6.Settings",
+                                                 append_ipv6), c),
+                  ==, OFONO_MODEM_CHANGED_CONTEXT_IPV6_SETTINGS);
+  g_assert_cmpstr(c->ipv6.interface, ==, "rmnet0");
+  g_assert_cmpstr(c->ipv6.address, ==, "2001:db8::1");
+  g_assert_cmpuint(c->ipv6.prefix_length, ==, 64);
+  g_assert_null(c->ipv4.interface);
+
+  modem_context_unref(c);
+}
+
+static void
+test_context_settings_bad_type(void)
+{
+  modem_context *c = modem_context_new(CONTEXT_PATH);
+
+  g_assert_cmphex(read_property(settings_changed("Settings",
+                                                 append_bad_type), c),
+                  ==, OFONO_MODEM_CHANGED_CONTEXT_SETTINGS);
+  g_assert_null(c->ipv4.address);
+  g_assert_cmpstr(c->ipv4.interface, ==, "rmnet1");
+
+  modem_context_unref(c);
+}
+
+int
+main(int argc, char *argv[])
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/context/settings", test_context_settings);
+  g_test_add_func("/context/ipv6-settings", test_context_ipv6_settings);
+  g_test_add_func("/context/settings-bad-type",
+                  test_context_settings_bad_type);
+
+  return g_test_run();
+}
@@ -0,0 +1,541 @@
+#include <glib.h>
+
+#include <string.h>
+
+#include "ofono-manager.h"
+#include "ofono-engine.h"
+#include "ofono-iface.h"
+#include "ofono-write.h"
+#include "string-pool.h"
+
+#define MODEM_PATH "/test_0"
+
+/* hold times are short, the tests wait for them on the default main context */
+#define HOLD 100
+
+/* The manager runs against a fake transport: watches are recorded instead of
+ * adding match rules and the test delivers the signals to them. The engine
+ * runs on the calling thread and the default main context, so notifications
+ * are plain function calls. */
+struct _watch
+{
+  const gchar *path;
+  ofono_iface_type type;
+  ofono_notify_fn cb;
+  gpointer user_data;
+};
+
+typedef struct _watch watch;
+
+struct _pending_call
+{
+  DBusMessage *message;
+  ofono_iface_reply_fn cb;
+  gpointer user_data;
+};
+
+typedef struct _pending_call pending_call;
+
+static GSList *watches = NULL;
+static GQueue calls = G_QUEUE_INIT;
+static GArray *changes = NULL;
+
+gboolean
+ofono_engine_start(GMainContext *notify_context, GError **error)
+{
+  return TRUE;
+}
+
+void
+ofono_engine_stop(void)
+{
+}
+
+gboolean
+ofono_engine_is_threaded(void)
+{
+  return FALSE;
+}
+
+DBusConnection *
+ofono_engine_get_connection(void)
+{
+  return NULL;
+}
+
+GMainContext *
+ofono_engine_get_context(void)
+{
+  return NULL;
+}
+
+GMainContext *
+ofono_engine_get_notify_context(void)
+{
+  return NULL;
+}
+
+guint
+ofono_engine_idle_add(GSourceFunc func, gpointer data)
+{
+  return g_idle_add(func, data);
+}
+
+guint
+ofono_engine_timeout_add(guint interval, GSourceFunc func, gpointer data)
+{
+  return g_timeout_add(interval, func, data);
+}
+
+void
+ofono_engine_source_remove(guint id)
+{
+  g_source_remove(id);
+}
+
+void
+ofono_engine_call(ofono_engine_fn fn, gpointer data)
+{
+  fn(data);
+}
+
+void
+ofono_engine_post(ofono_engine_fn fn, gpointer data)
+{
+  fn(data);
+}
+
+static watch *
+watch_find(const char *path, ofono_iface_type type)
+{
+  GSList *l;
+
+  for (l = watches; l; l = l->next)
+  {
+    watch *w = l->data;
+
+    if (!strcmp(w->path, path) && w->type == type)
+      return w;
+  }
+
+  return NULL;
+}
+
+gboolean
+ofono_iface_register(const char *path, ofono_iface_type type,
+                     ofono_notify_fn cb, gpointer user_data)
+{
+  watch *w = g_new(watch, 1);
+
+  w->path = string_pool_intern(path);
+  w->type = type;
+  w->cb = cb;
+  w->user_data = user_data;
+  watches = g_slist_prepend(watches, w);
+
+  return TRUE;
+}
+
+gboolean
+ofono_iface_watch(const char *path, ofono_iface_type type, ofono_notify_fn cb,
+                  gpointer user_data)
+{
+  return ofono_iface_register(path, type, cb, user_data);
+}
+
+void
+ofono_iface_close(const char *path, ofono_iface_type type, ofono_notify_fn cb,
+                  gpointer user_data)
+{
+  GSList *l = watches;
+
+  while (l)
+  {
+    watch *w = l->data;
+
+    l = l->next;
+
+    if (!strcmp(w->path, path) && w->type == type &&
+        ((!cb && !user_data) || (w->cb == cb && w->user_data == user_data)))
+    {
+      watches = g_slist_remove(watches, w);
+      g_free(w);
+    }
+  }
+}
+
+gboolean
+ofono_iface_watch_all(ofono_iface_type type)
+{
+  return TRUE;
+}
+
+void
+ofono_iface_unwatch_all(ofono_iface_type type)
+{
+}
+
+gboolean
+ofono_iface_call(ofono_iface_type type, DBusMessage *message,
+                 ofono_iface_reply_fn cb, gpointer user_data)
+{
+  pending_call *call = g_new(pending_call, 1);
+
+  call->message = dbus_message_ref(message);
+  call->cb = cb;
+  call->user_data = user_data;
+  g_queue_push_tail(&calls, call);
+
+  return TRUE;
+}
+
+/* only GetContexts, which is not answered here */
+gboolean
+ofono_iface_fetch_call(ofono_iface_type type, DBusMessage *message,
+                       ofono_iface_reply_fn cb, gpointer user_data)
+{
+  return FALSE;
+}
+
+void
+ofono_iface_set_call_timeout(gint timeout)
+{
+}
+
+void
+ofono_iface_fetch_task(const char *path, ofono_iface_type type, GTask *task)
+{
+}
+
+gboolean
+ofono_iface_fetch_finish(GAsyncResult *result, GError **error)
+{
+  return FALSE;
+}
+
+gboolean
+ofono_iface_fetch_pending(void)
+{
+  return FALSE;
+}
+
+void
+ofono_iface_fetch_done_register(ofono_notify_fn cb, gpointer user_data)
+{
+}
+
+void
+ofono_iface_fetch_done_close(ofono_notify_fn cb, gpointer user_data)
+{
+}
+
+gboolean
+ofono_write_property(const char *path, ofono_iface_type iface,
+                     const char *property, int type, const void *value,
+                     ofono_property_set_fn cb, gpointer user_data)
+{
+  return TRUE;
+}
+
+gboolean
+ofono_write_property_full(const char *path, ofono_iface_type iface,
+                          const char *property, int type, const void *value,
+                          ofono_property_set_result_fn cb, gpointer user_data)
+{
+  return TRUE;
+}
+
+static void
+append_variant(DBusMessageIter *dict, const char *key, int type,
+               const void *value)
+{
+  DBusMessageIter entry;
+  DBusMessageIter variant;
+  const char signature[] = {(char)type, '\0'};
+
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, signature,
+                                   &variant);
+  dbus_message_iter_append_basic(&variant, type, value);
+  dbus_message_iter_close_container(&entry, &variant);
+  dbus_message_iter_close_container(dict, &entry);
+}
+
+static void
+append_interfaces(DBusMessageIter *dict, const char **interfaces)
+{
+  const char *key = "Interfaces";
+  DBusMessageIter entry;
+  DBusMessageIter variant;
+  DBusMessageIter array;
+
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, "as", &variant);
+  dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY,
+                                   DBUS_TYPE_STRING_AS_STRING, &array);
+
+  for (; *interfaces; interfaces++)
+    dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, interfaces);
+
+  dbus_message_iter_close_container(&variant, &array);
+  dbus_message_iter_close_container(&entry, &variant);
+  dbus_message_iter_close_container(dict, &entry);
+}
+
+/* answers GetModems with a powered modem that has registration and
+ * connection manager interfaces */
+static void
+reply_get_modems(void)
+{
+  const char *interfaces[] =
+  {
+    OFONO_NETWORK_REGISTRATION_INTERFACE,
+    OFONO_CONNECTION_MANAGER_INTERFACE,
+    NULL
+  };
+  pending_call *call = g_queue_pop_head(&calls);
+  const char *path = MODEM_PATH;
+  dbus_bool_t powered = TRUE;
+  DBusMessage *reply;
+  DBusMessageIter iter;
+  DBusMessageIter array;
+  DBusMessageIter modem_iter;
+  DBusMessageIter dict;
+
+  g_assert_nonnull(call);
+  g_assert_true(dbus_message_has_member(call->message, "GetModems"));
+
+  reply = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+  dbus_message_iter_init_append(reply, &iter);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(oa{sv})",
+                                   &array);
+  dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT, NULL,
+                                   &modem_iter);
+  dbus_message_iter_append_basic(&modem_iter, DBUS_TYPE_OBJECT_PATH, &path);
+  dbus_message_iter_open_container(&modem_iter, DBUS_TYPE_ARRAY, "{sv}",
+                                   &dict);
+  append_variant(&dict, "Powered", DBUS_TYPE_BOOLEAN, &powered);
+  append_interfaces(&dict, interfaces);
+  dbus_message_iter_close_container(&modem_iter, &dict);
+  dbus_message_iter_close_container(&array, &modem_iter);
+  dbus_message_iter_close_container(&iter, &array);
+
+  call->cb(reply, call->user_data);
+
+  dbus_message_unref(reply);
+  dbus_message_unref(call->message);
+  g_free(call);
+}
+
+/* delivers a PropertyChanged signal of an interface of the modem */
+static void
+property_change(ofono_iface_type type, const char *property, int dbus_type,
+                const void *value)
+{
+  watch *w = watch_find(MODEM_PATH, type);
+  property_changed pc;
+
+  g_assert_nonnull(w);
+  pc.path = w->path;
+  pc.property = property;
+  pc.type = dbus_type;
+  memcpy(&pc.val, value, dbus_type == DBUS_TYPE_STRING ?
+         sizeof(const char *) : sizeof(guchar));
+  w->cb(&pc, w->user_data);
+}
+
+static void
+net_status(const char *status)
+{
+  property_change(OFONO_IFACE_NET, "Status", DBUS_TYPE_STRING, &status);
+}
+
+static void
+net_strength(guchar strength)
+{
+  property_change(OFONO_IFACE_NET, "Strength", DBUS_TYPE_BYTE, &strength);
+}
+
+static void
+net_name(const char *name)
+{
+  property_change(OFONO_IFACE_NET, "Name", DBUS_TYPE_STRING, &name);
+}
+
+static void
+modem_changed_cb(const gpointer data, gpointer user_data)
+{
+  const modem_changed *mc = data;
+
+  if (mc->type == OFONO_MANAGER_MODEM_CHANGE)
+    g_array_append_val(changes, mc->changed);
+}
+
+/* OFONO_MODEM_CHANGED_* mask of a change notification */
+static guint64
+change(guint index)
+{
+  g_assert_cmpuint(index, <, changes->len);
+
+  return g_array_index(changes, guint64, index);
+}
+
+/* runs the default main context for ms milliseconds */
+static void
+run_pending(guint ms)
+{
+  gint64 end = g_get_monotonic_time() + ms * 1000;
+
+  while (g_get_monotonic_time() < end)
+  {
+    while (g_main_context_iteration(NULL, FALSE))
+      ;
+
+    g_usleep(5000);
+  }
+
+  while (g_main_context_iteration(NULL, FALSE))
+    ;
+}
+
+static void
+setup(guint64 interests)
+{
+  changes = g_array_new(FALSE, FALSE, sizeof(guint64));
+  g_assert_true(ofono_manager_modems_register_full(modem_changed_cb, NULL,
+                                                   interests));
+  reply_get_modems();
+}
+
+static void
+teardown(void)
+{
+  ofono_manager_set_hold_time(OFONO_MODEM_CHANGED_NET_REGISTERED, 0);
+  ofono_manager_set_coalesce(FALSE, OFONO_MODEM_CHANGED_EMERGENCY);
+  ofono_manager_modems_close(modem_changed_cb, NULL);
+  run_pending(0);
+
+  g_assert_null(watches);
+  g_assert_true(g_queue_is_empty(&calls));
+  g_array_free(changes, TRUE);
+  changes = NULL;
+}
+
+/* a registration lost for less than the hold time is never notified */
+static void
+test_manager_hold_flap(void)
+{
+  hold_stats before;
+  hold_stats stats;
+
+  setup(OFONO_MODEM_INTERFACE_ALL);
+  g_assert_true(ofono_manager_set_hold_time(
+                  OFONO_MODEM_CHANGED_NET_REGISTERED, HOLD));
+  g_assert_true(ofono_manager_get_hold_stats(
+                  OFONO_MODEM_CHANGED_NET_REGISTERED, &before));
+
+  net_status("registered");
+  g_assert_cmpuint(changes->len, ==, 1);
+  g_assert_true(change(0) & OFONO_MODEM_CHANGED_NET_REGISTERED);
+
+  net_status("searching");
+  g_assert_cmpuint(changes->len, ==, 1);
+  net_status("registered");
+  g_assert_cmpuint(changes->len, ==, 1);
+
+  run_pending(HOLD * 2);
+  g_assert_cmpuint(changes->len, ==, 1);
+
+  g_assert_true(ofono_manager_get_hold_stats(
+                  OFONO_MODEM_CHANGED_NET_REGISTERED, &stats));
+  /* the statistics are never reset */
+  g_assert_cmpuint(stats.held - before.held, ==, 1);
+  g_assert_cmpuint(stats.absorbed - before.absorbed, ==, 1);
+  g_assert_cmpuint(stats.published - before.published, ==, 0);
+
+  teardown();
+}
+
+/* a loss lasting longer than the hold time is notified once it elapses */
+static void
+test_manager_hold_timeout(void)
+{
+  ofono_manager_set_hold_time(OFONO_MODEM_CHANGED_NET_REGISTERED, HOLD);
+  setup(OFONO_MODEM_INTERFACE_ALL);
+
+  net_status("registered");
+  net_status("searching");
+  g_assert_cmpuint(changes->len, ==, 1);
+
+  run_pending(HOLD * 2);
+  g_assert_cmpuint(changes->len, ==, 2);
+  g_assert_true(change(1) & OFONO_MODEM_CHANGED_NET_REGISTERED);
+
+  teardown();
+}
+
+/* changes within a main loop iteration are notified once, together */
+static void
+test_manager_coalesce(void)
+{
+  setup(OFONO_MODEM_INTERFACE_ALL);
+  ofono_manager_set_coalesce(TRUE, OFONO_MODEM_CHANGED_EMERGENCY);
+
+  net_strength(60);
+  net_name("Operator");
+  net_strength(70);
+  g_assert_cmpuint(changes->len, ==, 0);
+
+  run_pending(0);
+  g_assert_cmpuint(changes->len, ==, 1);
+  g_assert_cmphex(change(0), ==,
+                  OFONO_MODEM_CHANGED_NET_STRENGTH |
+                  OFONO_MODEM_CHANGED_NET_NAME);
+
+  teardown();
+}
+
+static void
+other_changed_cb(const gpointer data, gpointer user_data)
+{
+}
+
+/* interfaces are watched only while a consumer is interested in them */
+static void
+test_manager_interests(void)
+{
+  setup(OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION);
+
+  g_assert_nonnull(watch_find(MODEM_PATH, OFONO_IFACE_MODEM));
+  g_assert_nonnull(watch_find(MODEM_PATH, OFONO_IFACE_NET));
+  g_assert_null(watch_find(MODEM_PATH, OFONO_IFACE_CONN));
+  g_assert_null(watch_find(MODEM_PATH, OFONO_IFACE_CONTEXTS));
+
+  g_assert_true(ofono_manager_modems_register_full(
+                  other_changed_cb, NULL,
+                  OFONO_MODEM_INTERFACE_CONNECTION_MANAGER));
+  g_assert_nonnull(watch_find(MODEM_PATH, OFONO_IFACE_CONN));
+  g_assert_nonnull(watch_find(MODEM_PATH, OFONO_IFACE_CONTEXTS));
+
+  ofono_manager_modems_close(other_changed_cb, NULL);
+  g_assert_null(watch_find(MODEM_PATH, OFONO_IFACE_CONN));
+  g_assert_null(watch_find(MODEM_PATH, OFONO_IFACE_CONTEXTS));
+  g_assert_nonnull(watch_find(MODEM_PATH, OFONO_IFACE_NET));
+
+  teardown();
+}
+
+int
+main(int argc, char *argv[])
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/manager/hold-flap", test_manager_hold_flap);
+  g_test_add_func("/manager/hold-timeout", test_manager_hold_timeout);
+  g_test_add_func("/manager/coalesce", test_manager_coalesce);
+  g_test_add_func("/manager/interests", test_manager_interests);
+
+  return g_test_run();
+}
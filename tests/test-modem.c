@@ -0,0 +1,163 @@
+#include <glib.h>
+
+#include "modem.h"
+#include "string-pool.h"
+
+#define MODEM_PATH "/test_0"
+#define CONTEXT_PATH "/test_0/context1"
+
+static GHashTable *
+list_new(void)
+{
+  GHashTable *modems = modem_list_create();
+  modem *m = modem_list_insert(modems, modem_new(MODEM_PATH, FALSE));
+
+  modem_set_string(m, &m->imei, "123456789012345");
+  modem_set_string(m, &m->sim.spn, "Operator");
+  modem_set_string(m, &m->lte.apn, "internet");
+
+  return modems;
+}
+
+/* nobody else holds the record, it is modified in place */
+static void
+test_modem_modify_unshared(void)
+{
+  GHashTable *modems = list_new();
+  const gchar *path = string_pool_lookup(MODEM_PATH);
+  modem *m = modem_list_find(modems, path);
+  guint64 version = modem_version(m);
+
+  g_assert_true(modem_list_modify(modems, path) == m);
+  g_assert_cmpuint(modem_version(m), ==, version + 1);
+
+  modem_list_free(modems);
+}
+
+/* a snapshot keeps its contents, the list gets a modified copy */
+static void
+test_modem_modify_shared(void)
+{
+  GHashTable *modems = list_new();
+  const gchar *path = string_pool_lookup(MODEM_PATH);
+  const modem *snapshot = modem_ref(modem_list_find(modems, path));
+  guint64 version = modem_version(snapshot);
+  modem *m = modem_list_modify(modems, path);
+
+  g_assert_true(m != snapshot);
+  g_assert_true(modem_list_find(modems, path) == m);
+  g_assert_true(m->path == snapshot->path);
+  g_assert_cmpuint(modem_version(m), ==, version + 1);
+  g_assert_cmpuint(modem_version(snapshot), ==, version);
+
+  m->powered = TRUE;
+  modem_set_string(m, &m->imei, "543210987654321");
+  modem_set_string(m, &m->sim.spn, "Other");
+  modem_set_string(m, &m->lte.apn, "mms");
+
+  g_assert_false(snapshot->powered);
+  g_assert_cmpstr(snapshot->imei, ==, "123456789012345");
+  g_assert_cmpstr(snapshot->sim.spn, ==, "Operator");
+  g_assert_cmpstr(snapshot->lte.apn, ==, "internet");
+
+  /* the copy is not shared, so the next change is made in place */
+  g_assert_true(modem_list_modify(modems, path) == m);
+
+  /* the snapshot outlives the list */
+  modem_list_free(modems);
+  g_assert_cmpstr(snapshot->lte.apn, ==, "internet");
+  modem_unref(snapshot);
+}
+
+/* inline strings move to the copy, owned ones are copied, pooled ones are
+ * shared */
+static void
+test_modem_dup_strings(void)
+{
+  modem *m = modem_new(MODEM_PATH, TRUE);
+  modem *copy;
+
+  modem_set_string(m, &m->imei, "123456789012345");
+  modem_set_string(m, &m->net.mcc, "244");
+  modem_set_string(m, &m->sim.spn, "Operator");
+  modem_set_string(m, &m->lte.apn, "internet");
+
+  copy = modem_dup(m);
+  modem_unref(m);
+
+  g_assert_true(copy->powered);
+  g_assert_cmpstr(copy->imei, ==, "123456789012345");
+  g_assert_cmpstr(copy->net.mcc, ==, "244");
+  g_assert_true(copy->sim.spn == string_pool_lookup("Operator"));
+  g_assert_cmpstr(copy->lte.apn, ==, "internet");
+
+  modem_unref(copy);
+}
+
+/* a string too long for its slot is allocated, also after being inline */
+static void
+test_modem_string_overflow(void)
+{
+  GHashTable *modems = list_new();
+  const gchar *path = string_pool_lookup(MODEM_PATH);
+  const modem *snapshot = modem_ref(modem_list_find(modems, path));
+  modem *m = modem_list_modify(modems, path);
+
+  modem_set_string(m, &m->imei, "a serial number that does not fit");
+  g_assert_cmpstr(m->imei, ==, "a serial number that does not fit");
+  g_assert_cmpstr(snapshot->imei, ==, "123456789012345");
+
+  modem_set_string(m, &m->imei, NULL);
+  g_assert_null(m->imei);
+
+  modem_unref(snapshot);
+  modem_list_free(modems);
+}
+
+/* the context list of a snapshot is never modified */
+static void
+test_modem_contexts(void)
+{
+  GHashTable *modems = list_new();
+  const gchar *path = string_pool_lookup(MODEM_PATH);
+  modem *m = modem_list_modify(modems, path);
+  const modem *snapshot;
+  modem_context *c = modem_context_new(CONTEXT_PATH);
+
+  c->type = g_strdup("internet");
+  modem_set_context(m, c);
+
+  snapshot = modem_ref(m);
+  m = modem_list_modify(modems, path);
+  g_assert_true(m->contexts == snapshot->contexts);
+
+  c = modem_context_dup(modem_find_context(m, CONTEXT_PATH));
+  c->active = TRUE;
+  modem_set_context(m, c);
+
+  g_assert_true(m->contexts != snapshot->contexts);
+  g_assert_cmpint(modem_find_context(m, CONTEXT_PATH)->active, ==, TRUE);
+  g_assert_cmpint(modem_find_context(snapshot, CONTEXT_PATH)->active, ==, -1);
+  g_assert_true(modem_find_context_type(snapshot, "internet") != NULL);
+
+  g_assert_true(modem_remove_context(m, CONTEXT_PATH));
+  g_assert_null(modem_find_context(m, CONTEXT_PATH));
+  g_assert_nonnull(modem_find_context(snapshot, CONTEXT_PATH));
+
+  modem_list_free(modems);
+  modem_unref(snapshot);
+}
+
+int
+main(int argc, char *argv[])
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/modem/modify-unshared", test_modem_modify_unshared);
+  g_test_add_func("/modem/modify-shared", test_modem_modify_shared);
+  g_test_add_func("/modem/dup-strings", test_modem_dup_strings);
+  g_test_add_func("/modem/string-overflow", test_modem_string_overflow);
+  g_test_add_func("/modem/contexts", test_modem_contexts);
+
+  return g_test_run();
+}
@@ -0,0 +1,253 @@
+#include <glib.h>
+
+#include "notifier.h"
+
+/* Callbacks record their name, the action of an entry runs after that. */
+struct _entry
+{
+  const char *name;
+  void (*action)(struct _entry *e);
+  /** the entry the action works on */
+  struct _entry *other;
+};
+
+typedef struct _entry entry;
+
+static ofono_notifier_list *notifiers = NULL;
+static GString *calls = NULL;
+
+static void
+notify_cb(const gpointer data, gpointer user_data)
+{
+  entry *e = user_data;
+
+  g_string_append(calls, e->name);
+
+  if (e->action)
+    e->action(e);
+}
+
+static void
+close_other(entry *e)
+{
+  ofono_notifier_close(&notifiers, notify_cb, e->other);
+}
+
+static void
+close_self(entry *e)
+{
+  ofono_notifier_close(&notifiers, notify_cb, e);
+}
+
+static void
+close_all(entry *e)
+{
+  ofono_notifier_close(&notifiers, NULL, NULL);
+}
+
+static void
+register_other(entry *e)
+{
+  ofono_notifier_register(&notifiers, notify_cb, e->other);
+}
+
+/* the nested notification sees the tombstone of the outer one */
+static void
+close_other_and_notify(entry *e)
+{
+  ofono_notifier_close(&notifiers, notify_cb, e->other);
+  e->action = NULL;
+  g_string_append_c(calls, '(');
+  ofono_notifier_notify(notifiers, NULL);
+  g_string_append_c(calls, ')');
+}
+
+static const char *
+notify(void)
+{
+  g_string_truncate(calls, 0);
+  ofono_notifier_notify(notifiers, NULL);
+
+  return calls->str;
+}
+
+static void
+setup(void)
+{
+  calls = g_string_new(NULL);
+}
+
+static void
+teardown(void)
+{
+  ofono_notifier_close(&notifiers, NULL, NULL);
+  g_assert_null(notifiers);
+  g_string_free(calls, TRUE);
+  calls = NULL;
+}
+
+static void
+test_notifier_order(void)
+{
+  entry a = {"a", NULL, NULL};
+  entry b = {"b", NULL, NULL};
+  entry c = {"c", NULL, NULL};
+
+  setup();
+
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+  ofono_notifier_register(&notifiers, notify_cb, &b);
+  ofono_notifier_register(&notifiers, notify_cb, &c);
+  g_assert_cmpstr(notify(), ==, "abc");
+
+  ofono_notifier_close(&notifiers, notify_cb, &b);
+  g_assert_cmpstr(notify(), ==, "ac");
+
+  teardown();
+}
+
+/* a notifier closed by an earlier callback is skipped */
+static void
+test_notifier_close_later(void)
+{
+  entry c = {"c", NULL, NULL};
+  entry a = {"a", close_other, &c};
+  entry b = {"b", NULL, NULL};
+
+  setup();
+
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+  ofono_notifier_register(&notifiers, notify_cb, &b);
+  ofono_notifier_register(&notifiers, notify_cb, &c);
+  g_assert_cmpstr(notify(), ==, "ab");
+
+  a.action = NULL;
+  g_assert_cmpstr(notify(), ==, "ab");
+
+  teardown();
+}
+
+/* a callback closing itself does not disturb the ones after it */
+static void
+test_notifier_close_self(void)
+{
+  entry a = {"a", close_self, NULL};
+  entry b = {"b", NULL, NULL};
+  entry c = {"c", NULL, NULL};
+
+  setup();
+
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+  ofono_notifier_register(&notifiers, notify_cb, &b);
+  ofono_notifier_register(&notifiers, notify_cb, &c);
+  g_assert_cmpstr(notify(), ==, "abc");
+  g_assert_cmpstr(notify(), ==, "bc");
+
+  teardown();
+}
+
+/* a notifier registered meanwhile waits for the next notification, also when
+ * it makes the array grow */
+static void
+test_notifier_register(void)
+{
+  entry b = {"b", NULL, NULL};
+  entry a = {"a", register_other, &b};
+  entry fill[3] = {{"1", NULL, NULL}, {"2", NULL, NULL}, {"3", NULL, NULL}};
+  guint i;
+
+  setup();
+
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+
+  for (i = 0; i < G_N_ELEMENTS(fill); i++)
+    ofono_notifier_register(&notifiers, notify_cb, &fill[i]);
+
+  g_assert_cmpstr(notify(), ==, "a123");
+
+  a.action = NULL;
+  g_assert_cmpstr(notify(), ==, "a123b");
+
+  teardown();
+}
+
+/* closing every notifier during the notification frees the list only once
+ * the notification returns */
+static void
+test_notifier_close_all(void)
+{
+  entry a = {"a", close_all, NULL};
+  entry b = {"b", NULL, NULL};
+
+  setup();
+
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+  ofono_notifier_register(&notifiers, notify_cb, &b);
+  g_assert_cmpstr(notify(), ==, "a");
+  g_assert_null(notifiers);
+
+  /* a new list is started */
+  a.action = NULL;
+  ofono_notifier_register(&notifiers, notify_cb, &b);
+  g_assert_cmpstr(notify(), ==, "b");
+
+  teardown();
+}
+
+/* tombstones are only compacted once the outermost notification returns */
+static void
+test_notifier_nested(void)
+{
+  entry c = {"c", NULL, NULL};
+  entry a = {"a", close_other_and_notify, &c};
+  entry b = {"b", NULL, NULL};
+
+  setup();
+
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+  ofono_notifier_register(&notifiers, notify_cb, &b);
+  ofono_notifier_register(&notifiers, notify_cb, &c);
+  g_assert_cmpstr(notify(), ==, "a(ab)b");
+  g_assert_cmpstr(notify(), ==, "ab");
+
+  teardown();
+}
+
+/* only the notifiers matching both the callback and the user data go */
+static void
+test_notifier_close_match(void)
+{
+  entry a = {"a", NULL, NULL};
+  entry b = {"b", NULL, NULL};
+
+  setup();
+
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+  ofono_notifier_register(&notifiers, notify_cb, &b);
+  ofono_notifier_register(&notifiers, notify_cb, &a);
+  g_assert_cmpstr(notify(), ==, "aba");
+
+  ofono_notifier_close(&notifiers, notify_cb, &a);
+  g_assert_cmpstr(notify(), ==, "b");
+
+  ofono_notifier_close(&notifiers, notify_cb, &b);
+  g_assert_null(notifiers);
+
+  teardown();
+}
+
+int
+main(int argc, char *argv[])
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/notifier/order", test_notifier_order);
+  g_test_add_func("/notifier/close-later", test_notifier_close_later);
+  g_test_add_func("/notifier/close-self", test_notifier_close_self);
+  g_test_add_func("/notifier/register", test_notifier_register);
+  g_test_add_func("/notifier/close-all", test_notifier_close_all);
+  g_test_add_func("/notifier/nested", test_notifier_nested);
+  g_test_add_func("/notifier/close-match", test_notifier_close_match);
+
+  return g_test_run();
+}
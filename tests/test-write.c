@@ -0,0 +1,337 @@
+#include <glib.h>
+
+#include <string.h>
+
+#include "ofono-write.h"
+#include "ofono-engine.h"
+
+#define MODEM_PATH "/test_0"
+
+/* The write queues are tested against a fake transport: calls are recorded
+ * instead of being sent and the test answers them. The engine runs on the
+ * calling thread, so completions are plain function calls. */
+struct _sent_call
+{
+  DBusMessage *message;
+  ofono_iface_reply_fn cb;
+  gpointer user_data;
+};
+
+typedef struct _sent_call sent_call;
+
+struct _completion
+{
+  const char *name;
+  gboolean success;
+  gchar *error_name;
+};
+
+typedef struct _completion completion;
+
+static GQueue sent = G_QUEUE_INIT;
+static GPtrArray *completed = NULL;
+
+gboolean
+ofono_engine_is_threaded(void)
+{
+  return FALSE;
+}
+
+void
+ofono_engine_call(ofono_engine_fn fn, gpointer data)
+{
+  fn(data);
+}
+
+void
+ofono_engine_post(ofono_engine_fn fn, gpointer data)
+{
+  fn(data);
+}
+
+const char *
+ofono_iface_name(ofono_iface_type type)
+{
+  return OFONO_LTE_INTERFACE;
+}
+
+DBusMessage *
+ofono_iface_new_set_property(const char *path, ofono_iface_type type)
+{
+  return dbus_message_new_method_call(OFONO_SERVICE, path,
+                                      ofono_iface_name(type), "SetProperty");
+}
+
+gboolean
+ofono_iface_call(ofono_iface_type type, DBusMessage *message,
+                 ofono_iface_reply_fn cb, gpointer user_data)
+{
+  sent_call *call = g_new(sent_call, 1);
+
+  call->message = dbus_message_ref(message);
+  call->cb = cb;
+  call->user_data = user_data;
+  g_queue_push_tail(&sent, call);
+
+  return TRUE;
+}
+
+static void
+completion_free(gpointer data)
+{
+  completion *c = data;
+
+  g_free(c->error_name);
+  g_free(c);
+}
+
+static void
+write_result_cb(const property_set_result *result, gpointer user_data)
+{
+  completion *c = g_new(completion, 1);
+
+  c->name = user_data;
+  c->success = result->success;
+  c->error_name = g_strdup(result->error_name);
+  g_ptr_array_add(completed, c);
+}
+
+static void
+write_apn(const char *apn, const char *name)
+{
+  g_assert_true(ofono_write_property_full(MODEM_PATH, OFONO_IFACE_LTE,
+                                          "DefaultAccessPointName",
+                                          DBUS_TYPE_STRING, &apn,
+                                          write_result_cb, (gpointer)name));
+}
+
+/* value of the oldest call not answered yet */
+static const char *
+sent_apn(void)
+{
+  sent_call *call = g_queue_peek_head(&sent);
+  DBusMessageIter iter;
+  DBusMessageIter variant;
+  const char *property;
+  const char *value;
+
+  g_assert_nonnull(call);
+  g_assert_true(dbus_message_iter_init(call->message, &iter));
+  dbus_message_iter_get_basic(&iter, &property);
+  g_assert_cmpstr(property, ==, "DefaultAccessPointName");
+  g_assert_true(dbus_message_iter_next(&iter));
+  dbus_message_iter_recurse(&iter, &variant);
+  g_assert_cmpint(dbus_message_iter_get_arg_type(&variant), ==,
+                  DBUS_TYPE_STRING);
+  dbus_message_iter_get_basic(&variant, &value);
+
+  return value;
+}
+
+/* answers the oldest call, with an error if error_name is set, as cancelled
+ * if cancel is set */
+static void
+reply(const char *error_name, gboolean cancel)
+{
+  sent_call *call = g_queue_pop_head(&sent);
+  DBusMessage *reply = NULL;
+
+  g_assert_nonnull(call);
+
+  if (error_name)
+  {
+    reply = dbus_message_new(DBUS_MESSAGE_TYPE_ERROR);
+    dbus_message_set_error_name(reply, error_name);
+  }
+  else if (!cancel)
+    reply = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+  call->cb(reply, call->user_data);
+
+  if (reply)
+    dbus_message_unref(reply);
+
+  dbus_message_unref(call->message);
+  g_free(call);
+}
+
+static void
+assert_completed(guint index, const char *name, gboolean success,
+                 const char *error_name)
+{
+  completion *c;
+
+  g_assert_cmpuint(index, <, completed->len);
+  c = g_ptr_array_index(completed, index);
+  g_assert_cmpstr(c->name, ==, name);
+  g_assert_cmpint(c->success, ==, success);
+  g_assert_cmpstr(c->error_name, ==, error_name);
+}
+
+static void
+setup(void)
+{
+  completed = g_ptr_array_new_with_free_func(completion_free);
+}
+
+static void
+teardown(void)
+{
+  g_assert_true(g_queue_is_empty(&sent));
+  g_ptr_array_free(completed, TRUE);
+  completed = NULL;
+}
+
+static void
+test_write_single(void)
+{
+  setup();
+
+  write_apn("internet", "a");
+  g_assert_cmpuint(g_queue_get_length(&sent), ==, 1);
+  g_assert_cmpstr(sent_apn(), ==, "internet");
+  g_assert_cmpuint(completed->len, ==, 0);
+
+  reply(NULL, FALSE);
+  g_assert_cmpuint(completed->len, ==, 1);
+  assert_completed(0, "a", TRUE, NULL);
+
+  teardown();
+}
+
+/* a write of the value in flight joins the call */
+static void
+test_write_join(void)
+{
+  setup();
+
+  write_apn("internet", "a");
+  write_apn("internet", "b");
+  g_assert_cmpuint(g_queue_get_length(&sent), ==, 1);
+
+  reply(NULL, FALSE);
+  g_assert_cmpuint(completed->len, ==, 2);
+  assert_completed(0, "a", TRUE, NULL);
+  assert_completed(1, "b", TRUE, NULL);
+
+  teardown();
+}
+
+/* only the last of the values queued behind the call in flight is sent, the
+ * writers it superseded complete with it */
+static void
+test_write_last_wins(void)
+{
+  setup();
+
+  write_apn("internet", "a");
+  write_apn("mms", "b");
+  write_apn("wap", "c");
+  g_assert_cmpuint(g_queue_get_length(&sent), ==, 1);
+
+  reply(NULL, FALSE);
+  g_assert_cmpuint(completed->len, ==, 1);
+  assert_completed(0, "a", TRUE, NULL);
+  g_assert_cmpuint(g_queue_get_length(&sent), ==, 1);
+  g_assert_cmpstr(sent_apn(), ==, "wap");
+
+  reply(NULL, FALSE);
+  g_assert_cmpuint(completed->len, ==, 3);
+  assert_completed(1, "b", TRUE, NULL);
+  assert_completed(2, "c", TRUE, NULL);
+
+  teardown();
+}
+
+/* going back to the value in flight drops the queued one */
+static void
+test_write_back_to_current(void)
+{
+  setup();
+
+  write_apn("internet", "a");
+  write_apn("mms", "b");
+  write_apn("internet", "c");
+
+  reply(NULL, FALSE);
+  g_assert_cmpuint(completed->len, ==, 3);
+  assert_completed(0, "a", TRUE, NULL);
+  assert_completed(1, "b", TRUE, NULL);
+  assert_completed(2, "c", TRUE, NULL);
+
+  teardown();
+}
+
+/* an error completes the writers of the call, the queued value is still
+ * sent */
+static void
+test_write_error(void)
+{
+  setup();
+
+  write_apn("internet", "a");
+  write_apn("mms", "b");
+
+  reply("org.ofono.Error.InvalidFormat", FALSE);
+  g_assert_cmpuint(completed->len, ==, 1);
+  assert_completed(0, "a", FALSE, "org.ofono.Error.InvalidFormat");
+  g_assert_cmpstr(sent_apn(), ==, "mms");
+
+  reply(NULL, FALSE);
+  assert_completed(1, "b", TRUE, NULL);
+
+  teardown();
+}
+
+/* a cancelled call means the object is gone, the queued value is dropped */
+static void
+test_write_cancel(void)
+{
+  setup();
+
+  write_apn("internet", "a");
+  write_apn("mms", "b");
+
+  reply(NULL, TRUE);
+  g_assert_cmpuint(completed->len, ==, 2);
+  assert_completed(0, "a", FALSE, OFONO_PROPERTY_SET_ERROR_CANCELLED);
+  assert_completed(1, "b", FALSE, OFONO_PROPERTY_SET_ERROR_CANCELLED);
+
+  teardown();
+}
+
+/* once a call completed without anything queued the next write is sent */
+static void
+test_write_after_complete(void)
+{
+  setup();
+
+  write_apn("internet", "a");
+  reply(NULL, FALSE);
+
+  write_apn("internet", "b");
+  g_assert_cmpuint(g_queue_get_length(&sent), ==, 1);
+  g_assert_cmpstr(sent_apn(), ==, "internet");
+  reply(NULL, FALSE);
+
+  g_assert_cmpuint(completed->len, ==, 2);
+  assert_completed(1, "b", TRUE, NULL);
+
+  teardown();
+}
+
+int
+main(int argc, char *argv[])
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add_func("/write/single", test_write_single);
+  g_test_add_func("/write/join", test_write_join);
+  g_test_add_func("/write/last-wins", test_write_last_wins);
+  g_test_add_func("/write/back-to-current", test_write_back_to_current);
+  g_test_add_func("/write/error", test_write_error);
+  g_test_add_func("/write/cancel", test_write_cancel);
+  g_test_add_func("/write/after-complete", test_write_after_complete);
+
+  return g_test_run();
+}